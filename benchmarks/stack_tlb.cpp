@@ -0,0 +1,112 @@
+// Sums a large global int64 array several times, once with a 4 KiB page stack and once with
+// huge page backing, and reports wall time and dTLB load misses for each run.
+// Usage: stack_tlb_bench [elements] [passes]
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <sstream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "interpreter/processor.h"
+#include "interpreter/parser.h"
+#include "interpreter/analyzer.h"
+
+std::string arraySumProgram(size_t elements, size_t passes)
+{
+	std::ostringstream out;
+	out << "init:arr\ntype:int64[" << elements << "]\n"
+		"init:i\ntype:int64\n"
+		"init:pass\ntype:int64\n"
+		"init:sum\ntype:int64\n"
+		// arr[i] = i
+		"get\nvariable:i\nvalfromarg\nvalue:int64:1\nset\n"
+		"while\ninstructions\n"
+			"get\nvariable:i\nvalfromstlink\nvalfromarg\nvalue:int64:" << elements + 1 << "\nls\n"
+		"endInstructions\ninstructions\n"
+			"get\nvariable:arr\nget\nvariable:i\nvalfromstlink\ngetSublink\nget\nvariable:i\nvalfromstlink\nset\n"
+			"get\nvariable:i\nget\nvariable:i\nvalfromstlink\nvalfromarg\nvalue:int64:1\nadd\nset\n"
+		"endInstructions\n"
+		// sum += arr[i], passes times
+		"while\ninstructions\n"
+			"get\nvariable:pass\nvalfromstlink\nvalfromarg\nvalue:int64:" << passes << "\nls\n"
+		"endInstructions\ninstructions\n"
+			"get\nvariable:i\nvalfromarg\nvalue:int64:1\nset\n"
+			"while\ninstructions\n"
+				"get\nvariable:i\nvalfromstlink\nvalfromarg\nvalue:int64:" << elements + 1 << "\nls\n"
+			"endInstructions\ninstructions\n"
+				"get\nvariable:sum\n"
+				"get\nvariable:sum\nvalfromstlink\n"
+				"get\nvariable:arr\nget\nvariable:i\nvalfromstlink\ngetSublink\nvalfromstlink\n"
+				"add\nset\n"
+				"get\nvariable:i\nget\nvariable:i\nvalfromstlink\nvalfromarg\nvalue:int64:1\nadd\nset\n"
+			"endInstructions\n"
+			"get\nvariable:pass\nget\nvariable:pass\nvalfromstlink\nvalfromarg\nvalue:int64:1\nadd\nset\n"
+		"endInstructions\n"
+		"get\nvariable:sum\nvalfromstlink\nprintNum\n";
+	return out.str();
+}
+
+int openTlbCounter()
+{
+	perf_event_attr attr{};
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+void runOnce(const std::string& source, bool hugePages)
+{
+	Processor proc(0, hugePages);
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	Analyzer analyzer(&proc);
+	std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+	analyzer.specialize(proc.program());
+	if(!bounds.has_value())
+		throw std::runtime_error("array sum program is expected to be bounded");
+	proc.reserveStack(bounds->bytes(), bounds->elements(), bounds->operands());
+	proc.setStackBounded(true);
+
+	int counter = openTlbCounter();
+	if(counter >= 0)
+	{
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::cout << (hugePages ? "huge pages: sum " : "4 KiB pages: sum ");
+	proc.run();
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+	std::cout << ", " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms";
+	if(counter >= 0)
+	{
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+		long long misses = 0;
+		if(read(counter, &misses, sizeof(misses)) == sizeof(misses))
+			std::cout << ", " << misses << " dTLB load misses";
+		close(counter);
+	}
+	else
+		std::cout << ", dTLB counter unavailable";
+	std::cout << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	setValidationLevel(ValidationLevel::none);
+	size_t elements = argc > 1 ? std::stoull(argv[1]) : 1 << 18; // 2 MiB of int64
+	size_t passes = argc > 2 ? std::stoull(argv[2]) : 4;
+	std::string source = arraySumProgram(elements, passes);
+	runOnce(source, false);
+	runOnce(source, true);
+	return 0;
+}
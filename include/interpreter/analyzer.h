@@ -0,0 +1,71 @@
+#if !defined ANALYZER_H
+#define ANALYZER_H
+
+#include <vector>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <iterator>
+
+#include "processor.h"
+
+class StackBounds
+{
+	size_t bytes_;
+	size_t elements_;
+	size_t operands_;
+public:
+	StackBounds(size_t bytes = 0, size_t elements = 0, size_t operands = 0) : bytes_(bytes), elements_(elements), operands_(operands) {}
+
+	size_t bytes() const { return bytes_; } // frames and init_ elements on Stack
+	size_t elements() const { return elements_; } // Element records on Stack
+	size_t operands() const { return operands_; } // slots on OperandStack
+
+	StackBounds& operator+=(const StackBounds& other)
+	{
+		bytes_ += other.bytes_;
+		elements_ += other.elements_;
+		operands_ += other.operands_;
+		return *this;
+	}
+	StackBounds max(const StackBounds& other) const
+	{
+		return StackBounds(std::max(bytes_, other.bytes_), std::max(elements_, other.elements_), std::max(operands_, other.operands_));
+	}
+};
+
+class Analyzer // load-time worst case of stack usage, computed from the instructions alone
+{
+	typedef std::optional<TypeVariant> AbstractOperand; // nullopt when the type can't be known statically; links are LinkType(pointee)
+
+	class FunctionInfo
+	{
+	public:
+		const Function* function;
+		StackBounds own; // usage of the body itself
+		std::vector<FunctionType> callTypes; // types of functions called from the body
+		bool bounded;
+		FunctionInfo(const Function* func) : function(func), bounded(true) {}
+	};
+
+	Processor* processor_;
+	std::vector<FunctionInfo> functions_; // functions_[0] is the top level program
+	std::map<const Function*, size_t> functionIndexes_;
+	std::vector<std::optional<StackBounds>> chains_; // usage of every function together with its deepest callee chain
+	std::map<const Instruction*, std::optional<OpCode>> specializations_; // nullopt where operand types are unknown or differ between visits
+
+	void collectFunctions(const std::vector<Instruction>& instructions);
+	void recordSpecialization(const Instruction& inst, const std::vector<AbstractOperand>& operands);
+	size_t applySpecializations(std::vector<Instruction>& instructions);
+	void analyzeBody(FunctionInfo& info, const FrameLayout& frame, const std::vector<Instruction>& body);
+	bool simulate(FunctionInfo& info, const FrameLayout& frame, const std::vector<Instruction>& block, std::vector<AbstractOperand>& operands);
+	std::optional<StackBounds> chainBounds(size_t index, std::vector<uint8_t>& state);
+public:
+	Analyzer(Processor* processor);
+
+	std::optional<StackBounds> analyze(const std::vector<Instruction>& program); // nullopt for recursive or statically unknown programs
+	std::optional<StackBounds> functionBounds(const Function& function) const; // own usage of a function analyzed by the last analyze()
+	size_t specialize(std::vector<Instruction>& program); // rewrites math and compare instructions typed by the last analyze(program), returns their count
+};
+
+#endif
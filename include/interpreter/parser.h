@@ -84,15 +84,16 @@ class Parser
 	Processor* processor_;
 	
 	std::vector<FunctionScope> scopes_;
-	std::vector<size_t> currentFunctionOffsets_;
+	std::vector<FrameLayout*> currentFrames_;
 
 	std::optional<Variable> findVariable(const std::string& name) const;
 
 	std::optional<Argument> parseArgument(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end);
 	std::vector<Argument> parseArguments(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end);
 
-	Instruction parseInstruction(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end);
-	TypeVariant parseType(const std::string& name) const;
+	std::optional<Instruction> parseInstruction(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end);
+	TypeVariant parseType(const std::string& name) const; // memoized in the Processor's type cache
+	TypeVariant buildType(const std::string& name) const;
 public:
 	Parser(Processor* processor);
 	
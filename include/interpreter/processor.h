@@ -6,10 +6,14 @@
 #include <string>
 #include <variant>
 #include <map>
+#include <unordered_map>
 #include <optional>
 
 #include "variables/stack.h"
+#include "variables/operand.h"
+#include "variables/heap.h"
 #include "variables/type.h"
+#include "interpreter/simd.h"
 
 
 enum class OpCode
@@ -25,6 +29,8 @@ enum class OpCode
 	valfromstlink_, // value from StackLink
 	valfromarg_, // get value from argument
 	getSublink_, // get link on sub-element of link
+	getField_, // get link on a struct field of a variable, resolved by the parser to a frame offset
+	getSublinks_, // get link on an element of nested arrays by N indices at once, written as getSublink:N
 
 	
 	if_,
@@ -58,7 +64,79 @@ enum class OpCode
 	bg_, // bigger
 	beq_, // bigger or equals
 	equ_, // equals
-	neq_ // not equals
+	neq_, // not equals
+
+	// forms of the math and compare opcodes specialized to one operand type, emitted by Analyzer::specialize()
+	addI64_,
+	subI64_,
+	mulI64_,
+	divI64_,
+	modI64_,
+	shlI64_,
+	shrI64_,
+	lsI64_,
+	leqI64_,
+	bgI64_,
+	beqI64_,
+	equI64_,
+	neqI64_,
+
+	addChar_,
+	subChar_,
+	mulChar_,
+	divChar_,
+	modChar_,
+	shlChar_,
+	shrChar_,
+	lsChar_,
+	leqChar_,
+	bgChar_,
+	beqChar_,
+	equChar_,
+	neqChar_,
+
+	addF64_,
+	subF64_,
+	mulF64_,
+	divF64_,
+	lsF64_,
+	leqF64_,
+	bgF64_,
+	beqF64_,
+	equF64_,
+	neqF64_,
+
+	// element-wise operations over whole int64 or double arrays reached through links: result link, a link, b link
+	arrAdd_,
+	arrSub_,
+	arrMul_,
+	arrMin_,
+	arrMax_,
+	arrLs_, // result is a bool array of the same length
+	arrLeq_,
+	arrBg_,
+	arrBeq_,
+	arrEqu_,
+	arrNeq_,
+
+	// folds of a whole int64, char or double array reached through a link to one value of its element type,
+	// written reduceSum:fast etc. to let double folds reassociate
+	reduceSum_,
+	reduceProd_,
+	reduceMin_,
+	reduceMax_,
+	reduceDot_, // two array links
+	countEqu_, // array link and a value, gives int64 count of equal elements
+
+	// bulk moves over element ranges of arrays of any element type, bounds checked once per instruction;
+	// starts are 1-based like getSublink indexes
+	copyRange_, // destination link, destination start, source link, source start, count; ranges may overlap
+	fillRange_, // array link, start, count, value of the element type
+
+	alloc_, // type argument, gives a pointer to a zero-filled value of that type on the heap; alloc:region
+		// takes it from the region of the current Stack level instead, freed when the level is popped
+	free_, // pointer
+	deref_ // pointer, gives a link to the value it points to
 };
 
 std::optional<OpCode> parseOpcode(const std::string& str);
@@ -111,19 +189,69 @@ public:
 	bool isValid() const;
 };
 
-typedef std::variant<size_t, uint8_t*> Link;
+class Link // value on Stack, kept as a position rather than a pointer so it survives stack reallocation
+{
+public:
+	static constexpr uint32_t heapGeneration = UINT32_MAX; // marks links to heap and region values, whose offset is their address
+private:
+	size_t offset_; // byte position of the value on Stack
+	TypeId type_; // interned type of the value
+	uint32_t generation_; // of the frame holding the value, checked under validation to catch links outliving it
+public:
+	Link(size_t offset, TypeId type, uint32_t generation) : offset_(offset), type_(type), generation_(generation) {}
+
+	size_t offset() const { return offset_; }
+	TypeId type() const { return type_; }
+	uint32_t generation() const { return generation_; }
+	bool onHeap() const { return generation_ == heapGeneration; }
+};
 
 class Instruction;
 
+class FrameLayout // locals of one function, reserved on the stack as a single element
+{
+	std::vector<TypeVariant> types_;
+	std::vector<std::string> names_;
+	std::vector<size_t> offsets_; // byte offset of every slot from the frame base
+	std::vector<size_t> indexes_; // element sub-index of every slot inside the frame
+	mutable const StructType* type_; // owned by TypeTable, so copies of the layout share it; interned on first use, not per slot
+	size_t alignment_;
+	size_t end_; // end of the last slot, before padding the size up to alignment_
+	size_t size_;
+	size_t elementCount_;
+public:
+	FrameLayout() : type_(nullptr), alignment_(1), end_(0), size_(0), elementCount_(0) {}
+
+	size_t addSlot(const TypeVariant& type, const std::string& name); // returns sub-index of the new slot
+
+	bool empty() const { return types_.empty(); }
+	size_t slotCount() const { return types_.size(); }
+	size_t size() const { return size_; }
+	size_t elementCount() const { return elementCount_; }
+
+	const TypeVariant& slotType(size_t slot) const { return types_[slot]; }
+	const std::string& slotName(size_t slot) const { return names_[slot]; }
+	size_t slotOffset(size_t slot) const { return offsets_[slot]; }
+	size_t slotIndex(size_t slot) const { return indexes_[slot]; }
+	std::optional<size_t> slotByIndex(size_t index) const; // slot whose sub-index is index
+
+	const StructType& type() const;
+};
+
 class Function 
 {
 	FunctionType type_;
 	std::vector<Instruction> body_;
+	FrameLayout frame_;
 public:
 	Function() : type_(), body_() {}
-	Function(FunctionType type, const std::vector<Instruction>& body) : type_(type), body_(body){}
-	Function(const Function& other) : type_(other.type_), body_(other.body_) { /*std::cout << "Function copied" << std::endl;*/ }
-	Function(Function&& other) : type_(std::move(other.type_)), body_(std::move(other.body_)) {}
+	Function(FunctionType type, const std::vector<Instruction>& body) : type_(type), body_(body)
+	{
+		for(const TypeVariant& argumentType : type_.argumentsTypes()) // arguments take the first slots of the frame
+			frame_.addSlot(argumentType, "");
+	}
+	Function(const Function& other) : type_(other.type_), body_(other.body_), frame_(other.frame_) { /*std::cout << "Function copied" << std::endl;*/ }
+	Function(Function&& other) : type_(std::move(other.type_)), body_(std::move(other.body_)), frame_(std::move(other.frame_)) {}
 
 	Function& operator=(const Function& other) = default;
 
@@ -135,6 +263,8 @@ public:
 	const FunctionType& type() const { return type_; }
 	std::vector<Instruction>& body() { return body_; }
 	const std::vector<Instruction>& body() const { return body_; }
+	FrameLayout& frame() { return frame_; }
+	const FrameLayout& frame() const { return frame_; }
 };
 
 typedef std::variant<int64_t, char, bool, double, Function> Value;
@@ -164,6 +294,7 @@ public:
 		return *this;
 	}
 	OpCode opCode() const { return opCode_; }
+	void setOpCode(OpCode opCode) { opCode_ = opCode; }
 	const std::vector<Argument>& arguments() const { return arguments_; }
 	std::vector<Argument>& arguments() { return arguments_; }
 };
@@ -177,26 +308,97 @@ class Processor
 	friend class Parser;
 
 	std::vector<Instruction> program_;
-	std::map<std::string, BaseType> baseTypes_;
-	std::map<std::string, StructType> structs_;
+	std::map<std::string, const BaseType*> baseTypes_;
+	std::map<std::string, const StructType*> structs_;
+	std::unordered_map<std::string, TypeVariant> typeCache_; // type expressions already parsed by any Parser of this Processor
+	const BaseType* int64Type_; // resolved once, so handlers never look types up by name
+	const BaseType* charType_;
+	const BaseType* boolType_;
+	const BaseType* doubleType_;
 	
-	Stack stack_;
+	Stack stack_; // frames of locals
+	Heap heap_; // values made by alloc, released with the Processor
+	OperandStack operands_; // expression temporaries
+	FrameLayout globalFrame_;
 	std::vector<size_t> functionStackStartPositions_;
-	Stack FunctionReturnValues_;
+	std::vector<size_t> frameBases_; // byte position of every active frame on stack_, kept as positions to survive reallocation
+	std::vector<uint32_t> frameGenerations_; // generation of every active frame, ascending
+	uint32_t nextGeneration_;
 	bool finished_;
 	bool returningFromFunction_;
 	bool noBlockingInput_;
-	std::vector<uint8_t> returningValue_;
+	std::vector<size_t> returnSlots_; // operand reserved by every active call for its result, SIZE_MAX for void
 
+	struct Borrow // aggregate read through its source instead of copied, until either side is written
+	{
+		size_t source; // Stack position of the borrowed value
+		size_t size;
+		size_t target; // Stack position of the borrowing argument slot, or index of the borrowing operand
+		bool slot;
+	};
+	std::vector<Borrow> borrows_;
+	class ValueRanges // runs of an aggregate compared by equ/neq
+	{
+	public:
+		std::vector<std::pair<size_t, size_t>> bytes; // compared with memcmp, padding left out
+		std::vector<std::pair<size_t, size_t>> doubles; // compared by value, as scalar equ does
+	};
+	std::unordered_map<TypeId, ValueRanges> valueRanges_; // of every aggregate type compared so far
+	static constexpr size_t borrowThreshold_ = 64; // aggregates up to this size are cheaper to copy than to borrow
 
-	void functionEntry(size_t argumentsElementCount);
+	struct CachedOperand // scalar held outside operands_ until an instruction needs the real stack
+	{
+		const BaseType* type;
+		alignas(8) uint8_t data[8];
+	};
+	CachedOperand tos_[2]; // tos_[tosCount_ - 1] is the top operand
+	size_t tosCount_;
+
+	void spillTos();
+	size_t operandCount() const { return operands_.size() + tosCount_; }
+	const BaseType* scalarTypeFromEnd(size_t index); // nullptr if the operand is not a scalar
+	uint8_t* pushScalar(const BaseType* type);
+	const uint8_t* popScalar(); // valid until the next push
+	size_t saveOperands() { spillTos(); return operands_.size(); }
+	void restoreOperands(size_t level) { tosCount_ = 0; operands_.popTo(level); }
+
+
+	uint8_t* functionEntry(const FrameLayout& frame); // returns frame base, nullptr for an empty frame
 	void functionExit();
 
-	std::optional<int64_t> mathOper(int64_t(*operFunc)(int64_t a, int64_t b));
+	const uint8_t* linkData(const Link& link); // address of the linked value for reading, through pending borrows
+	uint8_t* writableLinkData(const Link& link); // copies out every borrow of the linked value first
+	const uint8_t* readData(size_t position); // follows borrowed argument slots to their source
+	const uint8_t* operandData(Operand& operand); // reads a borrowed operand through its source
+	bool borrowValid(const Borrow& borrow);
+	void materialize(const Borrow& borrow);
+	void borrowOperand(const TypeVariant& type, size_t source);
+	void pushLink(const Link& link);
+	std::optional<int64_t> pushFrameLink(Instruction& instruction); // get_ and getField_ resolved by the parser
+
+	std::optional<int64_t> mathOper(int64_t(*operFunc)(int64_t a, int64_t b), double(*doubleFunc)(double a, double b) = nullptr);
 	std::optional<int64_t> logicOper(bool(*operFunc)(bool a, bool b));
 	std::optional<int64_t> logicOper(bool(*operFunc)(bool a));
 
-	std::optional<int64_t> compareOper(bool(*operFunc)(int64_t a, int64_t b));
+	std::optional<int64_t> compareOper(CompareOp op, bool(*operFunc)(int64_t a, int64_t b), bool(*doubleFunc)(double a, double b));
+	std::optional<int64_t> aggregateCompare(CompareOp op, bool(*operFunc)(int64_t a, int64_t b)); // operFunc gets the memcmp order and 0
+	const ValueRanges& valueRanges(const TypeVariant& type);
+
+	std::optional<int64_t> arrayOper(ElementwiseOp op);
+	std::optional<int64_t> arrayCompare(CompareOp op);
+	std::optional<int64_t> reduceOper(Instruction& instruction, ReduceOp op);
+	std::optional<int64_t> dotOper(Instruction& instruction);
+	std::optional<int64_t> countOper();
+	size_t checkedRange(const Link& link, size_t startIndex, size_t countIndex); // byte offset of the range start in the array
+	std::optional<int64_t> copyRange_(Instruction& instruction);
+	std::optional<int64_t> fillRange_(Instruction& instruction);
+	std::optional<int64_t> alloc_(Instruction& instruction);
+	std::optional<int64_t> free_(Instruction& instruction);
+	std::optional<int64_t> deref_(Instruction& instruction);
+
+	template<typename T> const BaseType* scalarType() const;
+	template<typename T, typename Oper> std::optional<int64_t> typedMathOper(); // no type dispatch, operand types checked only under validation
+	template<typename T, typename Oper> std::optional<int64_t> typedCompareOper();
 
 
 	std::optional<int64_t> end_(Instruction& instruction);
@@ -211,6 +413,8 @@ class Processor
 	std::optional<int64_t> valfromstlink_(Instruction& instruction);
 	std::optional<int64_t> valfromarg_(Instruction& instruction);
 	std::optional<int64_t> getSublink_(Instruction& instruction);
+	std::optional<int64_t> getField_(Instruction& instruction);
+	std::optional<int64_t> getSublinks_(Instruction& instruction);
 
 	bool checkCondition(std::vector<Instruction>& condition);
 
@@ -252,8 +456,8 @@ class Processor
 
 	bool returningFromFunction() const { return returningFromFunction_; }
 	public:
-	Processor(const std::vector<Instruction>& program, size_t stackSize = 1 << 20);
-	Processor(size_t stackSize = 1 << 20);
+	Processor(const std::vector<Instruction>& program, size_t stackSize = 1 << 20, bool hugePages = false);
+	Processor(size_t stackSize = 1 << 20, bool hugePages = false);
 	void setProgram(const std::vector<Instruction>& program)
 	{
 		//std::cout << "start copy" << std::endl;
@@ -266,40 +470,52 @@ class Processor
 		program_ = std::move(program);
 		//std::cout << "stop copy" << std::endl;
 	}
+	const std::vector<Instruction>& program() const { return program_; }
+	std::vector<Instruction>& program() { return program_; }
 	std::optional<int64_t> run();
+	void reserveStack(size_t bytes, size_t elements = 0, size_t operands = 0); // must be called before run()
+	void setStackBounded(bool bounded) { stack_.setBounded(bounded); }
+	const Stack& stack() const { return stack_; }
 	void notifyStackReallocation(uint8_t* new_data);
 
-	std::map<std::string, BaseType>& baseTypes()
+	std::map<std::string, const BaseType*>& baseTypes()
 	{
 		return baseTypes_;
 	}
-	const std::map<std::string, BaseType>& baseTypes() const
+	const std::map<std::string, const BaseType*>& baseTypes() const
 	{
 		return baseTypes_;
 	}
+	const BaseType* int64Type() const { return int64Type_; }
+	const BaseType* charType() const { return charType_; }
+	const BaseType* boolType() const { return boolType_; }
+	const BaseType* doubleType() const { return doubleType_; }
 	bool finished();
 
-	std::map<std::string, StructType>& structs()
+	FrameLayout& globalFrame() { return globalFrame_; }
+	const FrameLayout& globalFrame() const { return globalFrame_; }
+
+	std::map<std::string, const StructType*>& structs()
 	{
 		return structs_;
 	}
-	const std::map<std::string, StructType>& structs() const
+	const std::map<std::string, const StructType*>& structs() const
 	{
 		return structs_;
 	}
 	void addStruct(const StructType& structType, std::string name)
 	{
-		structs_.insert({name, structType});
+		structs_.insert({name, TypeTable::instance().structType(structType)});
 	}
 
 	std::optional<TypeVariant> typeByName(const std::string& name) const
 	{
 		auto baseIt = baseTypes_.find(name);
 		if(baseIt != baseTypes_.end())
-			return TypeVariant(&baseIt->second);
+			return TypeVariant(baseIt->second);
 		auto structIt = structs_.find(name);
 		if(structIt != structs_.end())
-			return TypeVariant(&structIt->second);
+			return TypeVariant(structIt->second);
 		return std::nullopt;
 	}
 };
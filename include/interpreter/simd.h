@@ -0,0 +1,67 @@
+#if !defined SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel
+{
+	scalar = 0,
+	sse2 = 1,
+	avx2 = 2
+};
+
+SimdLevel detectedSimdLevel(); // what the CPU supports, detected on first use
+SimdLevel simdLevel();
+void setSimdLevel(SimdLevel level); // levels above detectedSimdLevel() are clamped, lower ones force the fallbacks
+
+enum class ElementwiseOp
+{
+	add,
+	sub,
+	mul,
+	min, // a < b ? a : b
+	max // a > b ? a : b
+};
+
+enum class CompareOp
+{
+	ls,
+	leq,
+	bg,
+	beq,
+	equ,
+	neq
+};
+
+// result[i] = a[i] op b[i]; result may be a or b, but must not overlap them otherwise
+void elementwise(ElementwiseOp op, const int64_t* a, const int64_t* b, int64_t* result, size_t count);
+void elementwise(ElementwiseOp op, const double* a, const double* b, double* result, size_t count);
+
+// mask[i] = a[i] op b[i]
+void compareMask(CompareOp op, const int64_t* a, const int64_t* b, bool* mask, size_t count);
+void compareMask(CompareOp op, const double* a, const double* b, bool* mask, size_t count);
+
+enum class ReduceOp
+{
+	sum, // integers wrap around like add
+	product,
+	min,
+	max
+};
+
+// fold of data[0..count) in index order, count must be at least 1; integer folds reassociate freely since the
+// result doesn't depend on the order, double folds only with reassociate set, otherwise they stay scalar and deterministic
+int64_t reduce(ReduceOp op, const int64_t* data, size_t count);
+char reduce(ReduceOp op, const char* data, size_t count);
+double reduce(ReduceOp op, const double* data, size_t count, bool reassociate);
+
+int64_t dot(const int64_t* a, const int64_t* b, size_t count);
+char dot(const char* a, const char* b, size_t count);
+double dot(const double* a, const double* b, size_t count, bool reassociate);
+
+size_t countEqual(const int64_t* data, int64_t value, size_t count);
+size_t countEqual(const char* data, char value, size_t count);
+size_t countEqual(const double* data, double value, size_t count);
+
+#endif
@@ -1,6 +1,8 @@
 #if !defined UTILS_H
 #define UTILS_H
 
+#include <cstddef>
+
 enum class ValidationLevel
 {
 	none = 0,
@@ -9,8 +11,32 @@ enum class ValidationLevel
 	full = 3
 };
 
-void setValidationLevel(ValidationLevel level);
-ValidationLevel getValidationLevel();
+#if !defined BPL_VALIDATION_LEVEL
+#define BPL_VALIDATION_LEVEL 3 // highest level compiled in; 0 builds without any validation code
+#endif
+
+constexpr ValidationLevel compiledValidationLevel = static_cast<ValidationLevel>(BPL_VALIDATION_LEVEL);
+
+extern ValidationLevel validationLevel_;
+
+void setValidationLevel(ValidationLevel level); // levels above compiledValidationLevel are clamped
+
+inline ValidationLevel getValidationLevel()
+{
+	if constexpr(compiledValidationLevel == ValidationLevel::none)
+		return ValidationLevel::none;
+	return validationLevel_;
+}
+
+inline bool validationEnabled(ValidationLevel level) // folds to false for levels not compiled in
+{
+	return level <= compiledValidationLevel && validationLevel_ >= level;
+}
+
+inline size_t alignUp(size_t value, size_t alignment) // alignment is a power of two
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
 
 bool getAllowResizeStack();
 void setAllowResizeStack(bool allow);
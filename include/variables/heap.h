@@ -0,0 +1,81 @@
+#if !defined HEAP_H
+#define HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+class Heap // memory behind alloc/free, pooled by size class and released all at once with the Heap
+{
+public:
+	static constexpr size_t minBlockSize = 16; // also the alignment of every block
+	static constexpr size_t maxBlockSize = 4096; // bigger blocks are allocated one by one
+	static constexpr size_t slabSize = 64 << 10;
+private:
+	static constexpr size_t classCount = 9; // 16, 32, ..., 4096 bytes
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+		uintptr_t poison; // freePoison ^ own address while the block is free, so a second free of it is noticed
+	};
+	static constexpr uintptr_t freePoison = 0x5a17f4eeb10c4e55;
+
+	// blocks carry no header: free gets the size back from the pointer type, so a block is exactly its class size
+	FreeBlock* freeLists_[classCount];
+	uint8_t* carve_[classCount]; // not yet handed out part of the newest slab of every class
+	uint8_t* carveEnd_[classCount];
+	std::vector<void*> slabs_;
+	std::unordered_set<void*> large_;
+	size_t liveBlocks_;
+
+	static size_t sizeClass(size_t size);
+	bool isFree(size_t index, const FreeBlock* block) const;
+public:
+	Heap();
+	~Heap();
+	Heap(const Heap& other) = delete;
+	Heap& operator=(const Heap& other) = delete;
+
+	uint8_t* allocate(size_t size); // zero-filled
+	void deallocate(uint8_t* data, size_t size); // size must be the one allocate got, nullptr is ignored, double frees throw under light validation
+	void clear(); // frees every block at once, including the ones never deallocated
+
+	size_t liveBlocks() const { return liveBlocks_; }
+};
+
+class Region // bump allocator freed only back to a mark, for values that die together
+{
+public:
+	static constexpr size_t chunkSize = 64 << 10;
+
+	struct Mark
+	{
+		size_t chunks;
+		size_t used;
+	};
+private:
+	struct Chunk
+	{
+		uint8_t* data;
+		size_t size;
+	};
+
+	std::vector<Chunk> chunks_; // in use, allocation bumps through the last one
+	std::vector<Chunk> spare_; // released chunks of chunkSize kept for reuse, so loops don't go to operator new
+	size_t used_; // bytes taken from the last chunk
+public:
+	Region() : used_(0) {}
+	~Region();
+	Region(const Region& other) = delete;
+	Region& operator=(const Region& other) = delete;
+
+	Mark mark() const { return Mark{chunks_.size(), used_}; }
+	uint8_t* allocate(size_t size); // zero-filled, aligned to Heap::minBlockSize
+	void release(Mark mark); // frees everything allocated after mark was taken
+	bool owns(const uint8_t* data) const;
+	bool released(const uint8_t* data) const; // in a chunk the region keeps but past the live extent, oversized chunks go back to operator delete and aren't seen
+};
+
+#endif
@@ -0,0 +1,95 @@
+#if !defined OPERAND_H
+#define OPERAND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <inttypes.h>
+#include <cstring>
+#include <stdexcept>
+
+#include "variables/type.h"
+
+class Operand
+{
+	friend class OperandStack;
+	alignas(8) uint8_t data_[16]; // the value itself, or its offset in the spill area when it doesn't fit
+	TypeVariant type_;
+	size_t size_;
+	size_t source_; // Stack position the value is still read through, SIZE_MAX once it holds its own copy
+public:
+	Operand() : size_(0), source_(SIZE_MAX) {}
+
+	const TypeVariant& type() const { return type_; }
+	size_t size() const { return size_; }
+	bool spilled() const { return size_ > sizeof(data_); }
+	bool borrowed() const { return source_ != SIZE_MAX; }
+	size_t source() const { return source_; }
+};
+
+class OperandStack // expression temporaries, kept apart from the frames in Stack
+{
+	std::vector<Operand> slots_;
+	size_t size_;
+	std::vector<uint8_t> spill_; // values wider than a slot, released in LIFO order with their slots
+	size_t spillTop_;
+public:
+	OperandStack(size_t capacity = 256);
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	size_t capacity() const { return slots_.size(); }
+
+	void reserve(size_t capacity); // exact sizing before use, allowed only on an empty OperandStack
+
+	uint8_t* push(const TypeVariant& type);
+	uint8_t* borrow(const TypeVariant& type, size_t source); // storage is reserved but left unfilled until detach
+	void detach(Operand& operand) { operand.source_ = SIZE_MAX; } // the caller has copied the value in
+	void pop();
+	void pop(size_t count);
+	void popTo(size_t size);
+
+	Operand& at(size_t index)
+	{
+		if(index >= size_)
+			throw std::runtime_error("OperandStack::at(size_t) index out of range");
+		return slots_[index];
+	}
+	const Operand& at(size_t index) const
+	{
+		if(index >= size_)
+			throw std::runtime_error("OperandStack::at(size_t) index out of range");
+		return slots_[index];
+	}
+
+	Operand& fromEnd(size_t index)
+	{
+		if(index >= size_)
+			throw std::runtime_error("OperandStack::fromEnd(size_t) index out of range");
+		return slots_[size_ - 1 - index];
+	}
+	const Operand& fromEnd(size_t index) const
+	{
+		if(index >= size_)
+			throw std::runtime_error("OperandStack::fromEnd(size_t) index out of range");
+		return slots_[size_ - 1 - index];
+	}
+
+	uint8_t* data(Operand& operand)
+	{
+		if(operand.spilled())
+			return spill_.data() + *reinterpret_cast<size_t*>(operand.data_);
+		return operand.data_;
+	}
+	const uint8_t* data(const Operand& operand) const
+	{
+		if(operand.spilled())
+			return spill_.data() + *reinterpret_cast<const size_t*>(operand.data_);
+		return operand.data_;
+	}
+
+	uint8_t* dataFromEnd(size_t index) { return data(fromEnd(index)); }
+	const uint8_t* dataFromEnd(size_t index) const { return data(fromEnd(index)); }
+};
+
+#endif
@@ -8,8 +8,10 @@
 #include <inttypes.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 
 #include "variables/type.h"
+#include "variables/heap.h"
 
 class Processor;
 
@@ -51,39 +53,22 @@ public:
 		else if(typeV.isStructType())
 		{
 			const StructType* structType = std::get<const StructType*>(typeV);
-			size_t pos = structType->types().size()/2;
-			size_t step = pos/2;
-			std::vector<size_t> structSubIndexes = structType->elementSubIndexes();
-			while(structSubIndexes[pos] != subIndex)
-			{
-				if(step == 0)
-					step = 1;
-				if(structSubIndexes[pos] > subIndex)
-				{
-					pos -= step;
-				}
-				else
-				{
-					if(structSubIndexes[pos] + structType->types()[pos].size() > subIndex)
-					{
-						Element element(ElementInfo(/*"", */structType->types()[pos]), pos_ + structType->offsetBySize(pos), index_ + structSubIndexes[pos]);
-						return element.at(subIndex - structSubIndexes[pos]);
-					}
-					pos += step;
-				}
-				step /= 2;
-			}
-			return Element(ElementInfo(/*"", */structType->types()[pos]), pos_, subIndex);
+			size_t field = structType->fieldBySubIndex(subIndex);
+			size_t fieldSubIndex = structType->elementSubIndex(field);
+			Element element(ElementInfo(/*"", */structType->type(field)), pos_ + structType->offsetBySize(field), index_ + fieldSubIndex);
+			return element.at(subIndex - fieldSubIndex);
 		}
 		else if(typeV.isArrayType())
 		{
 			const ArrayType& arrayType = std::get<ArrayType>(typeV);
-			size_t elementSize = arrayType.elementType().elementCount();
+			size_t elementSize = arrayType.elementElementCount();
 			size_t arrayIndex = (subIndex - 1) / elementSize;
 			size_t elementIndex = (subIndex - 1) % elementSize;
 			if(arrayIndex >= arrayType.count())
 				return std::nullopt;
-			Element element(ElementInfo(/*"", */arrayType.elementType()), pos_ + arrayIndex * arrayType.elementType().size());
+			Element element(ElementInfo(/*"", */arrayType.elementType()), pos_ + arrayType.offset(arrayIndex + 1), index_ + arrayType.elementSubIndex(arrayIndex + 1));
+			if(elementIndex == 0)
+				return element;
 			return element.at(elementIndex);
 		}
 		throw std::runtime_error("Element::at(size_t) called on unsupported TypeVariant type");
@@ -105,13 +90,10 @@ public:
 		}
 		if(typeV.isArrayType())
 		{
-			ArrayType arrayType = typeV.get<ArrayType>();
+			const ArrayType& arrayType = typeV.get<ArrayType>();
 			if(subIndex > arrayType.count())
 				throw std::out_of_range("Element::atSubElements(size_t) out of range");
-			TypeVariant elementType = arrayType.elementType();
-			size_t elementSize = elementType.size();
-			size_t elementsInElement = elementType.elementCount();
-			return Element(ElementInfo(/*"", */elementType), pos_ + elementSize*(subIndex-1), index_ + 1 + elementsInElement*(subIndex-1));
+			return Element(ElementInfo(/*"", */arrayType.elementType()), pos_ + arrayType.offset(subIndex), index_ + arrayType.elementSubIndex(subIndex));
 		}
 		throw std::runtime_error("Element::atSubElements(size_t) called on unsupported TypeVariant type");
 	}
@@ -136,14 +118,29 @@ class Stack
 	Processor* processor_;
 	size_t capacity_;
 	size_t elementCounter_;
+	size_t watermark_; // everything from here to capacity_ is known to be zero
 	bool cleanStackBeforeUse_;
+	bool bounded_; // capacity_ is a proven upper bound, push skips the overflow check
+	bool hugePages_; // back data_ with 2 MiB pages
+	bool hugetlb_; // data_ comes from MAP_HUGETLB rather than madvise
+	bool transparentHuge_; // data_ was madvise'd for transparent huge pages
+	size_t mapped_; // bytes actually mapped, capacity_ rounded up to the page size in use
+	Region region_; // values allocated for a level, freed when the level is popped
+	std::vector<std::pair<size_t, Region::Mark>> regionLevels_; // level and region mark of every level that allocated, innermost last
+
+	void cleanAboveTop();
+	size_t mappingSize(size_t capacity) const;
+	void map(size_t capacity);
+	void remap(size_t capacity);
 public:
-	Stack(Processor* processor, size_t capacity = 1 << 20, bool cleanStackBeforeUse = false);
+	Stack(Processor* processor, size_t capacity = 1 << 20, bool cleanStackBeforeUse = false, bool hugePages = false);
 	
 	~Stack();
 	
 	size_t capacity() const { return capacity_; }
+	uint8_t* data() { return data_; }
 	size_t top() const { return top_; }
+	size_t watermark() const { return watermark_; }
 	size_t size() const { return top_; }
 	bool empty() const { return top_ == 0; }
 	
@@ -164,6 +161,11 @@ public:
 	void pop(size_t count);
 
 	void setCleanStackBeforeUse(bool clean) { cleanStackBeforeUse_ = clean; }
+	void setBounded(bool bounded) { bounded_ = bounded; }
+	bool bounded() const { return bounded_; }
+	bool hugePages() const { return hugePages_; }
+	bool hugetlb() const { return hugetlb_; }
+	bool transparentHuge() const { return transparentHuge_; }
 	bool cleanStackBeforeUse() const { return cleanStackBeforeUse_; }
 	
 	size_t currentLevel() const { return levels_.size(); }
@@ -171,6 +173,9 @@ public:
 	void popLevel();
 	void deleteLevel() { popLevel(); return; }
 	void popToLevel(size_t level);
+	uint8_t* regionAllocate(size_t size); // zero-filled, lives until the current level is popped
+	bool regionOwns(const uint8_t* data) const { return region_.owns(data); }
+	bool regionReleased(const uint8_t* data) const { return region_.released(data); } // allocated for a level that was popped
 
 	std::optional<uint8_t*> at(size_t index);
 	std::optional<const uint8_t*> at(size_t index) const;
@@ -191,6 +196,7 @@ public:
 	std::optional<const uint8_t*> atFromEnd(size_t index) const;
 
 	void resize(size_t new_capacity);
+	void reserve(size_t capacity, size_t elementCount = 0); // exact sizing before use, allowed only on an empty Stack
 	void clear();
 
 };
@@ -9,6 +9,11 @@
 #include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <inttypes.h>
 
 #include "utils.h"
 
@@ -33,33 +38,33 @@ public:
 
 class TypeVariant;
 
+typedef uint32_t TypeId; // index in TypeTable, 0 means "no type"
+
 
 class FunctionType
 {
-	std::vector<TypeVariant> argumentsTypes_;
-	std::unique_ptr<TypeVariant> returnType_;
+	uint32_t signature_; // interned (return type, arguments types), 0 when not set
 public:
-	FunctionType() : returnType_(nullptr) {}
+	FunctionType() : signature_(0) {}
 	FunctionType(const std::vector<TypeVariant>& argumentsTypes, TypeVariant returnType);
 	
 	bool isValid() const;
 
-	FunctionType(FunctionType&&);
-	FunctionType(const FunctionType&);
-	FunctionType& operator=(FunctionType&&);
-	FunctionType& operator=(const FunctionType&);
+	FunctionType(FunctionType&&) = default;
+	FunctionType(const FunctionType&) = default;
+	FunctionType& operator=(FunctionType&&) = default;
+	FunctionType& operator=(const FunctionType&) = default;
 
-	bool operator==(const FunctionType& other) const;
+	bool operator==(const FunctionType& other) const { return signature_ == other.signature_; }
 	bool operator!=(const FunctionType& other) const { return !(*this == other); }
 
 	size_t size() const;
-	bool hasReturnType() const { return returnType_ != nullptr; }
+	bool hasReturnType() const { return signature_ != 0; }
 	const TypeVariant& returnType() const;
-	TypeVariant& returnType();
 	const std::vector<TypeVariant>& argumentsTypes() const;
-	std::vector<TypeVariant>& argumentsTypes();
+	uint32_t signature() const { return signature_; }
 
-	// Safely set return type (allocates internal returnType_)
+	// Safely set return type (re-interns the signature)
 	void setReturnType(const TypeVariant& rt);
 
 	size_t elemetCount() const { return 1; }
@@ -69,21 +74,22 @@ public:
 
 class PointerType
 {
-	std::unique_ptr<TypeVariant> pointerType_;
+	TypeId pointerType_;
 public:
 	PointerType(TypeVariant pointerType);
 
 	bool isValid() const;
 
-	PointerType(const PointerType& other);
-	PointerType(PointerType&& other);
-	PointerType& operator=(const PointerType& other);
-	PointerType& operator=(PointerType&& other);
+	PointerType(const PointerType& other) = default;
+	PointerType(PointerType&& other) = default;
+	PointerType& operator=(const PointerType& other) = default;
+	PointerType& operator=(PointerType&& other) = default;
 
-	bool operator==(const PointerType& other) const;
+	bool operator==(const PointerType& other) const { return pointerType_ == other.pointerType_; }
 	bool operator!=(const PointerType& other) const { return !(*this == other); }
 
-	TypeVariant pointerType() const;
+	const TypeVariant& pointerType() const;
+	TypeId pointerTypeId() const { return pointerType_; }
 	size_t size() const { return sizeof(void*); }
 
 	size_t elementCount() const { return 1; }
@@ -92,24 +98,26 @@ public:
 
 class LinkType
 {
-	std::unique_ptr<TypeVariant> elementType_;
+	TypeId elementType_; // 0 for links into the Stack, whose element carries the type
 public:
 	LinkType(TypeVariant elementType);
-	LinkType();
-	LinkType(const LinkType& other);
-	LinkType(LinkType&& other);
+	LinkType() : elementType_(0) {}
+	static LinkType byId(TypeId elementType) { LinkType link; link.elementType_ = elementType; return link; } // no interning
+	LinkType(const LinkType& other) = default;
+	LinkType(LinkType&& other) = default;
 
-	LinkType operator=(const LinkType& other);
-	LinkType operator=(LinkType&& other);
+	LinkType& operator=(const LinkType& other) = default;
+	LinkType& operator=(LinkType&& other) = default;
 	
 	bool isValid() const;
 
 	size_t size() const;
-	bool isGlobal() const { return elementType_ != nullptr; }
+	bool isGlobal() const { return elementType_ != 0; }
 	std::optional<TypeVariant> pointsTo() const;
+	TypeId pointsToId() const { return elementType_; }
 
 
-	bool operator==(const LinkType&) const { return true; }
+	bool operator==(const LinkType& other) const { return elementType_ == other.elementType_; }
 	bool operator!=(const LinkType& other) const { return !(*this == other); }
 
 	size_t elementCount() const { return 1; }
@@ -118,37 +126,55 @@ public:
 
 class ArrayType
 {
-	std::unique_ptr<TypeVariant> elementType_;
+	TypeId elementType_;
 	size_t count_;
 public:
 	ArrayType(TypeVariant elementType, size_t count);
-	ArrayType(ArrayType&& other);
-	ArrayType(const ArrayType& other);
-	ArrayType& operator=(ArrayType&& other);
-	ArrayType& operator=(const ArrayType& other);
+	ArrayType(ArrayType&& other) = default;
+	ArrayType(const ArrayType& other) = default;
+	ArrayType& operator=(ArrayType&& other) = default;
+	ArrayType& operator=(const ArrayType& other) = default;
 
 	bool isValid() const;
 
-	bool operator==(const ArrayType& other) const;
+	bool operator==(const ArrayType& other) const { return elementType_ == other.elementType_ && count_ == other.count_; }
 	bool operator!=(const ArrayType& other) const { return !(*this == other); }
 
-	TypeVariant elementType() const;
+	const TypeVariant& elementType() const;
+	TypeId elementTypeId() const { return elementType_; }
 	size_t count() const;
 	size_t size() const;
+	size_t elementSize() const; // bytes of one element
+	size_t elementElementCount() const; // sub-elements of one element, itself included
 
 	size_t elementCount() const;
-	std::vector<size_t> elementSubIndexes() const;
+	size_t elementSubIndex(size_t index) const { return index == 0 ? 0 : 1 + (index - 1) * elementElementCount(); } // index is 1-based, as in getSublink
+	size_t offset(size_t index) const { return index == 0 ? 0 : (index - 1) * elementSize(); }
 };
 
 
 
+enum class StructLayout
+{
+	packed, // fields follow each other without padding
+	natural // every field starts at a multiple of its own alignment
+};
+
 class StructType
 {
 	std::vector<TypeVariant> types_;
 	std::vector<std::string> fieldNames_;
+	StructLayout layout_;
+	size_t alignment_;
 	size_t totalSize_;
+	size_t elementCount_;
+	std::vector<size_t> offsets_; // offsets_[i] is the byte offset of field i (1-based), offsets_[0] == 0 for the struct itself
+	std::vector<size_t> subIndexes_; // subIndexes_[i] is the element sub-index of field i, same numbering as offsets_
+	std::vector<TypeId> typeIds_; // typeIds_[i] is the interned type of field i, same numbering, typeIds_[0] == 0
 public:
-	StructType(const std::vector<TypeVariant>& types, const std::vector<std::string>& fieldNames);
+	// alignment 0 keeps the layout's own alignment: 1 for packed, the largest field alignment for natural;
+	// an explicit alignment (e.g. 64 for a cache line) raises it and pads the size up to a multiple of it
+	StructType(const std::vector<TypeVariant>& types, const std::vector<std::string>& fieldNames, StructLayout layout = StructLayout::packed, size_t alignment = 0);
 	StructType(StructType&&) = default;
 	StructType(const StructType&) = default;
 	StructType& operator=(StructType&&) = default;
@@ -160,16 +186,20 @@ public:
 	bool operator!=(const StructType& other) const { return !(*this == other); }
 
 	size_t size() const;
+	StructLayout layout() const { return layout_; }
+	size_t alignment() const { return alignment_; }
 
 	const std::vector<TypeVariant>& types() const;
 	TypeVariant type(size_t index) const;
+	TypeId typeId(size_t index) const { return typeIds_[index]; } // index >= 1
 	const std::vector<std::string>& fieldNames() const { return fieldNames_; }
 
-	size_t elementCount() const { return types_.size() + 1; }
-	std::vector<size_t> elementSubIndexes() const;
+	size_t elementCount() const { return elementCount_; }
+	const std::vector<size_t>& elementSubIndexes() const { return subIndexes_; }
 	size_t elementSubIndex(size_t index) const;
+	size_t fieldBySubIndex(size_t subIndex) const; // field (1-based) whose elements contain subIndex, 0 for the struct itself
 	size_t offsetBySize(size_t index) const;
-	std::vector<size_t> offsetsBySize() const; // Returns offsets of struct and its fields
+	const std::vector<size_t>& offsetsBySize() const; // Returns offsets of struct and its fields
 };
 
 
@@ -236,11 +266,17 @@ public:
 	bool isArrayType() const;
 	bool isLinkType() const;
 	size_t size() const;
+	size_t alignment() const; // start of the type on Stack and inside natural structs is a multiple of it
+	void valueRanges(std::vector<std::pair<size_t, size_t>>& ranges, size_t offset = 0) const; // appends the (offset, size) runs holding values, padding left out
+	// same, but values of baseType go to baseRuns instead of ranges, for callers that compare them by value rather than by bytes
+	void valueRanges(std::vector<std::pair<size_t, size_t>>& ranges, const BaseType* baseType, std::vector<std::pair<size_t, size_t>>& baseRuns, size_t offset = 0) const;
 	size_t elementCount() const;
 	
 	bool operator!=(const TypeVariant& other) const;
 	bool operator==(const TypeVariant& other) const;
 
+	TypeId id() const; // interns the type on first use
+
 	template<typename T>
 	T& get() 
 	{
@@ -255,4 +291,125 @@ public:
 };
 
 
+class TypeTable // process-wide set of distinct types, every compound type refers to its parts by TypeId
+{
+	class Signature
+	{
+	public:
+		std::vector<TypeVariant> argumentsTypes;
+		TypeVariant returnType;
+	};
+
+	class Entry
+	{
+	public:
+		TypeVariant type;
+		size_t size;
+		size_t elementCount;
+	};
+
+	template<typename T>
+	class StableArray // append-only, entries never move, so readers index it without taking the lock
+	{
+		static constexpr size_t chunkBits = 10;
+		static constexpr size_t chunkSize = size_t(1) << chunkBits;
+		static constexpr size_t initialChunks = 4;
+		std::atomic<std::atomic<T*>*> chunks_; // directory of chunks, replaced by a doubled copy when full
+		size_t capacity_; // chunks the current directory holds, only used under the table's lock
+		std::vector<std::unique_ptr<std::atomic<T*>[]>> directories_; // every directory published, readers may still hold an older one
+		std::atomic<size_t> size_;
+	public:
+		StableArray() : capacity_(initialChunks), size_(0)
+		{
+			directories_.emplace_back(new std::atomic<T*>[capacity_]());
+			chunks_.store(directories_.back().get(), std::memory_order_release);
+		}
+		~StableArray()
+		{
+			std::atomic<T*>* chunks = chunks_.load();
+			for(size_t chunk = 0; chunk * chunkSize < size_.load(); ++chunk)
+				delete[] chunks[chunk].load();
+		}
+
+		size_t size() const { return size_.load(std::memory_order_acquire); }
+		const T& operator[](size_t index) const
+		{
+			return chunks_.load(std::memory_order_acquire)[index >> chunkBits].load(std::memory_order_acquire)[index & (chunkSize - 1)];
+		}
+		size_t push_back(T value) // caller holds the table's lock
+		{
+			size_t index = size_.load(std::memory_order_relaxed);
+			std::atomic<T*>* chunks = chunks_.load(std::memory_order_relaxed);
+			if((index >> chunkBits) == capacity_)
+			{
+				std::atomic<T*>* grown = new std::atomic<T*>[capacity_ * 2]();
+				directories_.emplace_back(grown);
+				for(size_t chunk = 0; chunk < capacity_; ++chunk)
+					grown[chunk].store(chunks[chunk].load(std::memory_order_relaxed), std::memory_order_relaxed);
+				capacity_ *= 2;
+				chunks_.store(grown, std::memory_order_release);
+				chunks = grown;
+			}
+			if((index & (chunkSize - 1)) == 0)
+				chunks[index >> chunkBits].store(new T[chunkSize], std::memory_order_release);
+			chunks[index >> chunkBits].load(std::memory_order_relaxed)[index & (chunkSize - 1)] = std::move(value);
+			size_.store(index + 1, std::memory_order_release);
+			return index;
+		}
+	};
+
+	StableArray<Entry> entries_;
+	class Key // children are already interned, so a fixed-size key identifies the whole type without allocating
+	{
+	public:
+		uint64_t kind;
+		uint64_t parts[3];
+		bool operator==(const Key& other) const { return kind == other.kind && parts[0] == other.parts[0] && parts[1] == other.parts[1] && parts[2] == other.parts[2]; }
+	};
+	class KeyHash
+	{
+	public:
+		size_t operator()(const Key& key) const;
+	};
+
+	std::mutex mutex_; // guards every insertion, lookups by id don't take it
+	std::unordered_map<Key, TypeId, KeyHash> ids_;
+	StableArray<Signature> signatures_;
+	std::unordered_map<std::string, uint32_t> signatureIds_;
+	// base and struct types are referred to by address, so the table owns them for the whole process
+	std::deque<BaseType> baseTypes_;
+	std::unordered_map<std::string, const BaseType*> baseTypeNames_;
+	std::deque<StructType> structTypes_;
+	std::unordered_map<std::string, const StructType*> structTypeIds_;
+
+	TypeTable();
+	Key key(const TypeVariant& type) const;
+	bool ownsBaseType(const BaseType* baseType) const;
+	const StructType* canonicalStructType(const StructType& structType); // caller holds mutex_
+public:
+	TypeTable(const TypeTable&) = delete;
+	TypeTable& operator=(const TypeTable&) = delete;
+
+	static TypeTable& instance();
+
+	const BaseType* baseType(const std::string& name, size_t size); // the one BaseType of that name
+	const StructType* structType(const StructType& structType); // the one StructType with these fields, names and layout
+	size_t structCount(); // distinct struct types owned by the table
+
+	TypeId intern(const TypeVariant& type);
+	uint32_t internSignature(const std::vector<TypeVariant>& argumentsTypes, const TypeVariant& returnType);
+
+	const TypeVariant& type(TypeId id) const { return entries_[id].type; }
+	size_t size(TypeId id) const { return entries_[id].size; }
+	size_t elementCount(TypeId id) const { return entries_[id].elementCount; }
+	size_t count() const { return entries_.size() - 1; }
+
+	const std::vector<TypeVariant>& signatureArguments(uint32_t signature) const { return signatures_[signature].argumentsTypes; }
+	const TypeVariant& signatureReturn(uint32_t signature) const { return signatures_[signature].returnType; }
+};
+
+inline size_t ArrayType::elementSize() const { return TypeTable::instance().size(elementType_); }
+inline size_t ArrayType::elementElementCount() const { return TypeTable::instance().elementCount(elementType_); }
+
+
 #endif
\ No newline at end of file
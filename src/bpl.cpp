@@ -4,6 +4,7 @@
 
 #include "interpreter/processor.h"
 #include "interpreter/parser.h"
+#include "interpreter/analyzer.h"
 
 std::vector<std::string> readFile(const std::string& path)
 {
@@ -25,18 +26,35 @@ std::vector<std::string> readFile(const std::string& path)
 int main(int argc, char** argv)
 {
 	setValidationLevel(ValidationLevel::basic);
-	Processor proc(1 << 20);
 
-	if(argc < 2)
+	bool hugePages = false;
+	int argIndex = 1;
+	if(argIndex < argc && std::string(argv[argIndex]) == "--huge-pages")
 	{
-		std::cerr << "Usage: " << argv[0] << " <source-file>" << std::endl;
+		hugePages = true;
+		++argIndex;
+	}
+	if(argIndex >= argc)
+	{
+		std::cerr << "Usage: " << argv[0] << " [--huge-pages] <source-file>" << std::endl;
 		return 1;
 	}
-	std::string path = argv[1];
+	Processor proc(0, hugePages);
+	std::string path = argv[argIndex];
 	std::vector<std::string> code = readFile(path);
 	Parser parser(&proc);
 	std::vector<Instruction> prog = parser.parse(code);
-	proc.setProgram(prog);
+	proc.setProgram(std::move(prog));
+	Analyzer analyzer(&proc);
+	std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+	analyzer.specialize(proc.program());
+	if(bounds.has_value())
+	{
+		proc.reserveStack(bounds->bytes(), bounds->elements(), bounds->operands());
+		proc.setStackBounded(true);
+	}
+	else
+		proc.reserveStack(1 << 20);
 	proc.run();
 	return 0;
 }
\ No newline at end of file
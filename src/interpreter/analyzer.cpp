@@ -0,0 +1,432 @@
+#include "interpreter/analyzer.h"
+
+Analyzer::Analyzer(Processor* processor) : processor_(processor)
+{
+	if(processor_ == nullptr)
+		throw std::invalid_argument("Analyzer::Analyzer(Processor*) null Processor pointer");
+}
+
+void Analyzer::collectFunctions(const std::vector<Instruction>& instructions)
+{
+	for(const Instruction& inst : instructions)
+	{
+		for(const Argument& arg : inst.arguments())
+		{
+			if(std::holds_alternative<std::vector<Instruction>>(arg))
+			{
+				collectFunctions(std::get<std::vector<Instruction>>(arg));
+				continue;
+			}
+			if(!std::holds_alternative<Value>(arg) || !std::holds_alternative<Function>(std::get<Value>(arg)))
+				continue;
+			const Function& func = std::get<Function>(std::get<Value>(arg));
+			functionIndexes_.insert({&func, functions_.size()});
+			functions_.emplace_back(&func);
+			collectFunctions(func.body());
+		}
+	}
+}
+
+static std::optional<OpCode> specializedOpCode(OpCode generic, size_t kind) // kind: 0 int64, 1 char, 2 double
+{
+	static const OpCode generics[] = {OpCode::add_, OpCode::sub_, OpCode::mul_, OpCode::div_, OpCode::mod_, OpCode::shl_, OpCode::shr_,
+		OpCode::ls_, OpCode::leq_, OpCode::bg_, OpCode::beq_, OpCode::equ_, OpCode::neq_};
+	static const std::optional<OpCode> specialized[3][13] = {
+		{OpCode::addI64_, OpCode::subI64_, OpCode::mulI64_, OpCode::divI64_, OpCode::modI64_, OpCode::shlI64_, OpCode::shrI64_,
+			OpCode::lsI64_, OpCode::leqI64_, OpCode::bgI64_, OpCode::beqI64_, OpCode::equI64_, OpCode::neqI64_},
+		{OpCode::addChar_, OpCode::subChar_, OpCode::mulChar_, OpCode::divChar_, OpCode::modChar_, OpCode::shlChar_, OpCode::shrChar_,
+			OpCode::lsChar_, OpCode::leqChar_, OpCode::bgChar_, OpCode::beqChar_, OpCode::equChar_, OpCode::neqChar_},
+		{OpCode::addF64_, OpCode::subF64_, OpCode::mulF64_, OpCode::divF64_, std::nullopt, std::nullopt, std::nullopt,
+			OpCode::lsF64_, OpCode::leqF64_, OpCode::bgF64_, OpCode::beqF64_, OpCode::equF64_, OpCode::neqF64_}};
+	for(size_t i = 0; i < std::size(generics); ++i)
+	{
+		if(generics[i] == generic)
+			return specialized[kind][i];
+	}
+	return std::nullopt;
+}
+
+void Analyzer::recordSpecialization(const Instruction& inst, const std::vector<AbstractOperand>& operands)
+{
+	std::optional<OpCode> opCode;
+	if(operands.size() >= 2 && operands.back().has_value() && operands[operands.size() - 2] == operands.back() && operands.back()->isBaseType())
+	{
+		const BaseType* type = operands.back()->get<const BaseType*>();
+		if(type == processor_->int64Type())
+			opCode = specializedOpCode(inst.opCode(), 0);
+		else if(type == processor_->charType())
+			opCode = specializedOpCode(inst.opCode(), 1);
+		else if(type == processor_->doubleType())
+			opCode = specializedOpCode(inst.opCode(), 2);
+	}
+	std::pair<std::map<const Instruction*, std::optional<OpCode>>::iterator, bool> inserted = specializations_.insert({&inst, opCode});
+	if(!inserted.second && inserted.first->second != opCode)
+		inserted.first->second = std::nullopt;
+}
+
+static std::optional<TypeVariant> slotTypeByIndex(const FrameLayout& frame, size_t index)
+{
+	for(size_t i = 0; i < frame.slotCount(); ++i)
+	{
+		if(frame.slotIndex(i) == index)
+			return frame.slotType(i);
+	}
+	return std::nullopt;
+}
+
+bool Analyzer::simulate(FunctionInfo& info, const FrameLayout& frame, const std::vector<Instruction>& block, std::vector<AbstractOperand>& operands)
+{
+	auto pop = [&operands](size_t count) -> bool
+	{
+		if(operands.size() < count)
+			return false;
+		operands.resize(operands.size() - count);
+		return true;
+	};
+	auto push = [&operands, &info](AbstractOperand operand)
+	{
+		operands.push_back(std::move(operand));
+		info.own = info.own.max(StackBounds(0, 0, operands.size()));
+	};
+	auto subBlock = [&](const Argument& arg, size_t results) -> bool
+	{
+		std::vector<AbstractOperand> blockOperands = operands;
+		if(!simulate(info, frame, std::get<std::vector<Instruction>>(arg), blockOperands))
+			return false;
+		return blockOperands.size() >= operands.size() + results;
+	};
+
+	for(const Instruction& inst : block)
+	{
+		const std::vector<Argument>& args = inst.arguments();
+		switch(inst.opCode())
+		{
+		case OpCode::end_:
+		case OpCode::ret_:
+		case OpCode::stackRealloc_:
+			break;
+		case OpCode::call_:
+		{
+			if(operands.empty() || !operands.back().has_value() || !operands.back()->isFunctionType())
+				return false;
+			FunctionType type = operands.back()->get<FunctionType>();
+			if(!pop(1 + type.argumentsTypes().size()))
+				return false;
+			if(type.returnType().size() != 0)
+				push(type.returnType());
+			info.callTypes.push_back(std::move(type));
+			break;
+		}
+		case OpCode::init_:
+		{
+			if(args.size() != 1 || !std::holds_alternative<TypeVariant>(args[0]))
+				return false;
+			const TypeVariant& type = std::get<TypeVariant>(args[0]);
+			info.own += StackBounds(type.size() + type.alignment() - 1, 1, 0); // worst case padding below the element
+			break;
+		}
+		case OpCode::get_:
+		{
+			if(args.size() == 3 && std::holds_alternative<TypeVariant>(args[2])) // resolved by the parser, carries its link type
+			{
+				push(std::get<TypeVariant>(args[2]));
+				break;
+			}
+			if(args.size() != 1 || !std::holds_alternative<PreStackIndex>(args[0]))
+				return false;
+			PreStackIndex index = std::get<PreStackIndex>(args[0]);
+			std::optional<TypeVariant> pointee = slotTypeByIndex(index.isGlobal() ? processor_->globalFrame() : frame, index.index());
+			push(pointee.has_value() ? TypeVariant(LinkType(pointee.value())) : TypeVariant(LinkType()));
+			break;
+		}
+		case OpCode::getSublinks_:
+		{
+			if(args.size() != 1 || !std::holds_alternative<Value>(args[0]) || !std::holds_alternative<int64_t>(std::get<Value>(args[0])))
+				return false;
+			size_t indexCount = std::get<int64_t>(std::get<Value>(args[0]));
+			if(operands.size() < indexCount + 1)
+				return false;
+			AbstractOperand link = operands[operands.size() - indexCount - 1];
+			std::optional<TypeVariant> element = link.has_value() && link->isLinkType() ? link->get<LinkType>().pointsTo() : std::nullopt;
+			for(size_t i = 0; i < indexCount && element.has_value(); ++i)
+				element = element->isArrayType() ? std::optional<TypeVariant>(element->get<ArrayType>().elementType()) : std::nullopt;
+			pop(indexCount + 1);
+			push(element.has_value() ? TypeVariant(LinkType(element.value())) : TypeVariant(LinkType()));
+			break;
+		}
+		case OpCode::getField_:
+			if(args.size() != 3 || !std::holds_alternative<TypeVariant>(args[2]))
+				return false;
+			push(std::get<TypeVariant>(args[2]));
+			break;
+		case OpCode::set_:
+			if(!pop(2))
+				return false;
+			break;
+		case OpCode::valfromstlink_:
+		{
+			if(operands.empty())
+				return false;
+			AbstractOperand link = operands.back();
+			pop(1);
+			if(link.has_value() && link->isLinkType())
+				push(link->get<LinkType>().pointsTo());
+			else
+				push(std::nullopt);
+			break;
+		}
+		case OpCode::valfromarg_:
+		{
+			if(args.size() != 1 || !std::holds_alternative<Value>(args[0]))
+				return false;
+			const Value& val = std::get<Value>(args[0]);
+			if(std::holds_alternative<int64_t>(val))
+				push(TypeVariant(processor_->int64Type()));
+			else if(std::holds_alternative<char>(val))
+				push(TypeVariant(processor_->charType()));
+			else if(std::holds_alternative<bool>(val))
+				push(TypeVariant(processor_->boolType()));
+			else if(std::holds_alternative<double>(val))
+				push(TypeVariant(processor_->doubleType()));
+			else if(std::holds_alternative<Function>(val))
+				push(TypeVariant(std::get<Function>(val).type()));
+			break;
+		}
+		case OpCode::getSublink_:
+			if(!pop(2))
+				return false;
+			push(TypeVariant(LinkType()));
+			break;
+		case OpCode::if_:
+			if(args.size() < 2 || !subBlock(args[0], 1) || !subBlock(args[1], 0))
+				return false;
+			if(args.size() == 3 && !subBlock(args[2], 0))
+				return false;
+			break;
+		case OpCode::while_:
+			if(args.size() != 2 || !subBlock(args[0], 1) || !subBlock(args[1], 0))
+				return false;
+			break;
+		case OpCode::runInstsVec_:
+			if(args.size() != 1 || !subBlock(args[0], 0))
+				return false;
+			break;
+		case OpCode::add_:
+		case OpCode::sub_:
+		case OpCode::mul_:
+		case OpCode::div_:
+		case OpCode::mod_:
+		case OpCode::shl_:
+		case OpCode::shr_:
+			recordSpecialization(inst, operands);
+			if(!pop(1) || operands.empty())
+				return false;
+			break;
+		case OpCode::ls_:
+		case OpCode::leq_:
+		case OpCode::bg_:
+		case OpCode::beq_:
+		case OpCode::equ_:
+		case OpCode::neq_:
+			recordSpecialization(inst, operands);
+			if(!pop(2))
+				return false;
+			push(TypeVariant(processor_->boolType()));
+			break;
+		case OpCode::and_:
+		case OpCode::or_:
+			if(!pop(2))
+				return false;
+			push(TypeVariant(processor_->boolType()));
+			break;
+		case OpCode::addI64_: case OpCode::subI64_: case OpCode::mulI64_: case OpCode::divI64_:
+		case OpCode::modI64_: case OpCode::shlI64_: case OpCode::shrI64_:
+		case OpCode::addChar_: case OpCode::subChar_: case OpCode::mulChar_: case OpCode::divChar_:
+		case OpCode::modChar_: case OpCode::shlChar_: case OpCode::shrChar_:
+		case OpCode::addF64_: case OpCode::subF64_: case OpCode::mulF64_: case OpCode::divF64_:
+			if(!pop(1) || operands.empty())
+				return false;
+			break;
+		case OpCode::lsI64_: case OpCode::leqI64_: case OpCode::bgI64_: case OpCode::beqI64_: case OpCode::equI64_: case OpCode::neqI64_:
+		case OpCode::lsChar_: case OpCode::leqChar_: case OpCode::bgChar_: case OpCode::beqChar_: case OpCode::equChar_: case OpCode::neqChar_:
+		case OpCode::lsF64_: case OpCode::leqF64_: case OpCode::bgF64_: case OpCode::beqF64_: case OpCode::equF64_: case OpCode::neqF64_:
+			if(!pop(2))
+				return false;
+			push(TypeVariant(processor_->boolType()));
+			break;
+		case OpCode::arrAdd_: case OpCode::arrSub_: case OpCode::arrMul_: case OpCode::arrMin_: case OpCode::arrMax_:
+		case OpCode::arrLs_: case OpCode::arrLeq_: case OpCode::arrBg_: case OpCode::arrBeq_: case OpCode::arrEqu_: case OpCode::arrNeq_:
+			if(!pop(3))
+				return false;
+			break;
+		case OpCode::reduceSum_: case OpCode::reduceProd_: case OpCode::reduceMin_: case OpCode::reduceMax_:
+		case OpCode::reduceDot_:
+		{
+			size_t linkCount = inst.opCode() == OpCode::reduceDot_ ? 2 : 1;
+			if(operands.size() < linkCount)
+				return false;
+			AbstractOperand link = operands.back();
+			std::optional<TypeVariant> array = link.has_value() && link->isLinkType() ? link->get<LinkType>().pointsTo() : std::nullopt;
+			pop(linkCount);
+			push(array.has_value() && array->isArrayType() ? AbstractOperand(array->get<ArrayType>().elementType()) : std::nullopt);
+			break;
+		}
+		case OpCode::copyRange_:
+			if(!pop(5))
+				return false;
+			break;
+		case OpCode::fillRange_:
+			if(!pop(4))
+				return false;
+			break;
+		case OpCode::alloc_:
+			if(inst.arguments().empty() || !std::holds_alternative<TypeVariant>(inst.arguments()[0]))
+				return false;
+			push(TypeVariant(PointerType(std::get<TypeVariant>(inst.arguments()[0]))));
+			break;
+		case OpCode::free_:
+			if(!pop(1))
+				return false;
+			break;
+		case OpCode::deref_:
+		{
+			if(operands.empty())
+				return false;
+			AbstractOperand pointer = operands.back();
+			pop(1);
+			push(pointer.has_value() && pointer->isPointerType() ? TypeVariant(LinkType(pointer->get<PointerType>().pointerType())) : TypeVariant(LinkType()));
+			break;
+		}
+		case OpCode::countEqu_:
+			if(!pop(2))
+				return false;
+			push(TypeVariant(processor_->int64Type()));
+			break;
+		case OpCode::not_:
+			if(!pop(1))
+				return false;
+			push(TypeVariant(processor_->boolType()));
+			break;
+		case OpCode::setNoBlockingInput_:
+		case OpCode::printCh_:
+		case OpCode::printNum_:
+			if(!pop(1))
+				return false;
+			break;
+		case OpCode::checkBuf_:
+			push(TypeVariant(processor_->boolType()));
+			break;
+		case OpCode::readCh_:
+		case OpCode::peekCh_:
+			push(TypeVariant(processor_->charType()));
+			break;
+		case OpCode::readNum_:
+			push(TypeVariant(processor_->int64Type()));
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+void Analyzer::analyzeBody(FunctionInfo& info, const FrameLayout& frame, const std::vector<Instruction>& body)
+{
+	info.own = frame.empty() ? StackBounds() : StackBounds(frame.size() + frame.type().alignment() - 1, 1, 0);
+	std::vector<AbstractOperand> operands;
+	info.bounded = simulate(info, frame, body, operands);
+}
+
+std::optional<StackBounds> Analyzer::chainBounds(size_t index, std::vector<uint8_t>& state)
+{
+	if(state[index] == 2)
+		return chains_[index];
+	state[index] = 1;
+	const FunctionInfo& info = functions_[index];
+	std::optional<StackBounds> result;
+	if(info.bounded)
+	{
+		StackBounds deepest;
+		bool bounded = true;
+		for(size_t callee = 1; callee < functions_.size() && bounded; ++callee)
+		{
+			bool called = false;
+			for(const FunctionType& callType : info.callTypes)
+				called = called || callType == functions_[callee].function->type();
+			if(!called)
+				continue;
+			if(state[callee] == 1) // recursion
+			{
+				bounded = false;
+				break;
+			}
+			std::optional<StackBounds> calleeBounds = chainBounds(callee, state);
+			if(!calleeBounds.has_value())
+				bounded = false;
+			else
+				deepest = deepest.max(calleeBounds.value());
+		}
+		if(bounded)
+		{
+			result = info.own;
+			result.value() += deepest;
+			if(!info.callTypes.empty())
+				result.value() += StackBounds(0, 0, 1); // return slot reserved by the caller
+		}
+	}
+	chains_[index] = result;
+	state[index] = 2;
+	return result;
+}
+
+std::optional<StackBounds> Analyzer::analyze(const std::vector<Instruction>& program)
+{
+	functions_.clear();
+	functionIndexes_.clear();
+	specializations_.clear();
+	functions_.emplace_back(nullptr);
+	collectFunctions(program);
+	analyzeBody(functions_[0], processor_->globalFrame(), program);
+	for(size_t i = 1; i < functions_.size(); ++i)
+		analyzeBody(functions_[i], functions_[i].function->frame(), functions_[i].function->body());
+	chains_.assign(functions_.size(), std::nullopt);
+	std::vector<uint8_t> state(functions_.size(), 0);
+	return chainBounds(0, state);
+}
+
+std::optional<StackBounds> Analyzer::functionBounds(const Function& function) const
+{
+	std::map<const Function*, size_t>::const_iterator it = functionIndexes_.find(&function);
+	if(it == functionIndexes_.end() || !functions_[it->second].bounded)
+		return std::nullopt;
+	return functions_[it->second].own;
+}
+
+size_t Analyzer::applySpecializations(std::vector<Instruction>& instructions)
+{
+	size_t count = 0;
+	for(Instruction& inst : instructions)
+	{
+		std::map<const Instruction*, std::optional<OpCode>>::const_iterator it = specializations_.find(&inst);
+		if(it != specializations_.end() && it->second.has_value())
+		{
+			inst.setOpCode(it->second.value());
+			++count;
+		}
+		for(Argument& arg : inst.arguments())
+		{
+			if(std::holds_alternative<std::vector<Instruction>>(arg))
+				count += applySpecializations(std::get<std::vector<Instruction>>(arg));
+			else if(std::holds_alternative<Value>(arg) && std::holds_alternative<Function>(std::get<Value>(arg)))
+				count += applySpecializations(std::get<Function>(std::get<Value>(arg)).body());
+		}
+	}
+	return count;
+}
+
+size_t Analyzer::specialize(std::vector<Instruction>& program)
+{
+	size_t count = applySpecializations(program);
+	specializations_.clear(); // recorded sites are stale once rewritten
+	return count;
+}
@@ -40,7 +40,17 @@ std::optional<Variable> Parser::findVariable(const std::string& name) const
 	return std::nullopt;
 }
 
-TypeVariant Parser::parseType(const std::string& name) const // TODO:
+TypeVariant Parser::parseType(const std::string& name) const
+{
+	std::unordered_map<std::string, TypeVariant>::const_iterator cached = processor_->typeCache_.find(name);
+	if(cached != processor_->typeCache_.end())
+		return cached->second;
+	TypeVariant type = buildType(name);
+	processor_->typeCache_.emplace(name, type);
+	return type;
+}
+
+TypeVariant Parser::buildType(const std::string& name) const // TODO:
 {
 	size_t end = name.find_first_of("*[&(");
 	std::string baseTypeName = name.substr(0, end);
@@ -114,29 +124,38 @@ std::optional<Argument> Parser::parseArgument(std::vector<std::string>::const_it
 			scopes_.emplace_back();
 
 			std::vector<TypeVariant> localArgTypes;
+			std::vector<std::string> localArgNames;
 			localArgTypes.reserve(parts.size() - 3);
 			std::optional<TypeVariant> returnTypeOpt = parseType(parts[2]);
 			if(!returnTypeOpt.has_value())
 				throw std::runtime_error("Unknown return type in Function Value argument: " + parts[2]);
 			for(size_t i = 3; i < parts.size(); ++i)
 			{
-				std::optional<TypeVariant> argTypeOpt = parseType(parts[i]);
+				size_t space = parts[i].find(' '); // "type name" gives the argument a name inside the body
+				std::optional<TypeVariant> argTypeOpt = parseType(parts[i].substr(0, space));
 				if(!argTypeOpt.has_value())
 					throw std::runtime_error("Unknown argument type in Function Value argument: " + parts[i]);
 				localArgTypes.push_back(argTypeOpt.value());
+				localArgNames.push_back(space == std::string::npos ? "" : baseTrim(std::string_view(parts[i]).substr(space + 1)));
 			}
 			++(*it);
 
 			Function func(FunctionType(localArgTypes, returnTypeOpt.value()), std::vector<Instruction>());
 			std::vector<Instruction>& body = func.body();
+			for(size_t i = 0; i < localArgNames.size(); ++i)
+			{
+				if(!localArgNames[i].empty())
+					scopes_.back().insert(Variable(localArgTypes[i], PreStackIndex(func.frame().slotIndex(i))), localArgNames[i]);
+			}
+			currentFrames_.push_back(&func.frame());
 			while(**it != "end")
 			{
 				std::optional<Instruction> instrOpt = parseInstruction(it, end);
-				if(!instrOpt.has_value())
-					throw std::runtime_error("Unexpected end of program while parsing Function Value argument body");
-				body.push_back(instrOpt.value());
+				if(instrOpt.has_value())
+					body.push_back(instrOpt.value());
 			}
 			++(*it);
+			currentFrames_.pop_back();
 			scopes_.pop_back();
 
 			arg = Value(std::move(func));
@@ -220,9 +239,8 @@ std::optional<Argument> Parser::parseArgument(std::vector<std::string>::const_it
 		while(*it != end && **it != "endInstructions")
 		{
 			std::optional<Instruction> instrOpt = parseInstruction(it, end);
-			if(!instrOpt.has_value())
-				throw std::runtime_error("Unexpected end of program while parsing Instructions argument");
-			instructions.push_back(instrOpt.value());
+			if(instrOpt.has_value())
+				instructions.push_back(instrOpt.value());
 		}
 		if(*it == end)
 			throw std::runtime_error("Unexpected end of program while parsing Instructions argument");
@@ -252,7 +270,7 @@ std::vector<Argument> Parser::parseArguments(std::vector<std::string>::const_ite
 	return arguments;
 }
 
-Instruction Parser::parseInstruction(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end) //TODO: check errors
+std::optional<Instruction> Parser::parseInstruction(std::vector<std::string>::const_iterator* it, const std::vector<std::string>::const_iterator& end) //TODO: check errors
 {
 	//std::cout << **it << std::endl;
 	OpCode opCode;
@@ -280,11 +298,70 @@ Instruction Parser::parseInstruction(std::vector<std::string>::const_iterator* i
 			throw std::runtime_error("Invalid argument type for init instruction, expected TypeVariant");
 		TypeVariant varType = std::get<TypeVariant>(arguments[0]);
 
-		size_t varOffset = currentFunctionOffsets_.back();
-		currentFunctionOffsets_.back() += varType.elementCount();
+		// locals live in the function's frame, which is reserved in one piece on function entry
+		size_t varOffset = currentFrames_.back()->addSlot(varType, varName);
 		scopes_.back().insert(Variable(varType, PreStackIndex(varOffset)), varName);
+		return std::nullopt;
+	}
+	if(opCode == OpCode::get_ || opCode == OpCode::getField_) // get or getField:a.b with variable:x resolve x or x.a.b to a constant offset from the frame base
+	{
+		if(parts.size() != (opCode == OpCode::get_ ? 1 : 2))
+			throw std::runtime_error("Invalid " + parts[0] + " instruction format: " + **it);
+		++(*it);
+		std::vector<std::string> varParts = *it == end ? std::vector<std::string>() : split(**it, ':');
+		if(varParts.size() != 2 || varParts[0] != "variable")
+			throw std::runtime_error(parts[0] + " instruction expects a variable argument");
+		std::optional<Variable> varOpt = findVariable(varParts[1]);
+		if(!varOpt.has_value())
+			throw std::runtime_error("Unknown variable name in " + parts[0] + " instruction: " + varParts[1]);
+		++(*it);
+		Variable var = varOpt.value();
+		const FrameLayout* frame = var.index().isGlobal() ? &processor_->globalFrame_ : currentFrames_.back();
+		std::optional<size_t> slot = frame->slotByIndex(var.index().index());
+		if(!slot.has_value())
+			throw std::runtime_error("Variable is not a frame slot in " + parts[0] + " instruction: " + varParts[1]);
+		size_t offset = frame->slotOffset(slot.value());
+		TypeVariant type = var.type();
+		for(const std::string& fieldName : parts.size() == 2 ? split(parts[1], '.') : std::vector<std::string>())
+		{
+			if(!type.isStructType())
+				throw std::runtime_error("getField instruction applied to a non-struct type: " + parts[1]);
+			const StructType* structType = type.get<const StructType*>();
+			const std::vector<std::string>& fieldNames = structType->fieldNames();
+			std::vector<std::string>::const_iterator field = std::find(fieldNames.begin(), fieldNames.end(), fieldName);
+			if(field == fieldNames.end())
+				throw std::runtime_error("Unknown struct field in getField instruction: " + fieldName);
+			size_t fieldIndex = field - fieldNames.begin() + 1;
+			offset += structType->offsetBySize(fieldIndex);
+			type = structType->type(fieldIndex);
+		}
+		return Instruction(opCode, {var.index(), Value(static_cast<int64_t>(offset)), TypeVariant(LinkType(type))});
+	}
+	if(parts.size() == 2 && (opCode == OpCode::reduceSum_ || opCode == OpCode::reduceProd_ || opCode == OpCode::reduceMin_ ||
+		opCode == OpCode::reduceMax_ || opCode == OpCode::reduceDot_)) // reduceSum:fast lets double folds reassociate
+	{
+		if(parts[1] != "fast")
+			throw std::runtime_error("Unknown modifier in " + parts[0] + " instruction: " + parts[1]);
+		++(*it);
+		return Instruction(opCode, {Value(true)});
+	}
+	if(opCode == OpCode::alloc_ && parts.size() == 2) // alloc:region frees the value with the enclosing level
+	{
+		if(parts[1] != "region")
+			throw std::runtime_error("Unknown modifier in alloc instruction: " + parts[1]);
+		++(*it);
+		arguments = parseArguments(it, end);
+		arguments.push_back(Value(true));
 		return Instruction(opCode, arguments);
 	}
+	if(opCode == OpCode::getSublink_ && parts.size() == 2) // getSublink:N takes N indices at once
+	{
+		int64_t indexCount = std::stoll(parts[1]);
+		if(indexCount < 1)
+			throw std::runtime_error("Invalid index count in getSublink instruction: " + parts[1]);
+		++(*it);
+		return Instruction(OpCode::getSublinks_, {Value(indexCount)});
+	}
 	++(*it);
 	arguments = parseArguments(it, end);
 	return Instruction(opCode, arguments);
@@ -315,25 +392,23 @@ std::vector<Instruction> Parser::parse(std::string_view programm) //TODO:
 {
 	std::vector<Instruction> instructions;
 	std::vector<std::string> lines = split(programm, '\n');
-	for(size_t i = 0, j = 0; i < lines.size(); ++i , ++j)
+	size_t j = 0;
+	for(size_t i = 0; i < lines.size(); ++i)
 	{
 		std::string line = trim(std::move(lines[i]));
 		if(line.empty())
-		{
-			--j;
 			continue;
-		}
-		lines[j] = line;
+		lines[j++] = line;
 	}
+	lines.resize(j);
 	scopes_.emplace_back();
-	currentFunctionOffsets_.push_back(0);
+	currentFrames_.push_back(&processor_->globalFrame_);
 	std::vector<std::string>::const_iterator it = lines.cbegin();
 	while(it != lines.cend())
 	{
 		std::optional<Instruction> instrOpt = parseInstruction(&it, lines.cend());
-		if(!instrOpt.has_value())
-			throw std::runtime_error("Cannot parse instruction: " + *it);
-		instructions.push_back(instrOpt.value());
+		if(instrOpt.has_value())
+			instructions.push_back(instrOpt.value());
 	}
 	return instructions;
 	
@@ -352,14 +427,13 @@ std::vector<Instruction> Parser::parse(const std::vector<std::string>& programm)
 	}
 	std::vector<Instruction> instructions;
 	scopes_.emplace_back();
-	currentFunctionOffsets_.push_back(0);
+	currentFrames_.push_back(&processor_->globalFrame_);
 	std::vector<std::string>::const_iterator it = lines.cbegin();
 	while(it != lines.cend())
 	{
 		std::optional<Instruction> instrOpt = parseInstruction(&it, lines.cend());
-		if(!instrOpt.has_value())
-			throw std::runtime_error("Cannot parse instruction: " + *it);
-		instructions.push_back(instrOpt.value());
+		if(instrOpt.has_value())
+			instructions.push_back(instrOpt.value());
 	}
 	return instructions;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "utils.h"
 #include <sys/select.h>
 #include <unistd.h>
+#include <functional>
+#include <algorithm>
 
 std::optional<OpCode> parseOpcode(const std::string& str)
 {
@@ -23,6 +25,8 @@ std::optional<OpCode> parseOpcode(const std::string& str)
 		return OpCode::valfromarg_;
 	else if(str == "getSublink")
 		return OpCode::getSublink_;
+	else if(str == "getField")
+		return OpCode::getField_;
 	else if(str == "if")
 		return OpCode::if_;
 	else if(str == "while")
@@ -77,6 +81,50 @@ std::optional<OpCode> parseOpcode(const std::string& str)
 		return OpCode::equ_;
 	else if(str == "neq")
 		return OpCode::neq_;
+	else if(str == "arrAdd")
+		return OpCode::arrAdd_;
+	else if(str == "arrSub")
+		return OpCode::arrSub_;
+	else if(str == "arrMul")
+		return OpCode::arrMul_;
+	else if(str == "arrMin")
+		return OpCode::arrMin_;
+	else if(str == "arrMax")
+		return OpCode::arrMax_;
+	else if(str == "arrLs")
+		return OpCode::arrLs_;
+	else if(str == "arrLeq")
+		return OpCode::arrLeq_;
+	else if(str == "arrBg")
+		return OpCode::arrBg_;
+	else if(str == "arrBeq")
+		return OpCode::arrBeq_;
+	else if(str == "arrEqu")
+		return OpCode::arrEqu_;
+	else if(str == "arrNeq")
+		return OpCode::arrNeq_;
+	else if(str == "reduceSum")
+		return OpCode::reduceSum_;
+	else if(str == "reduceProd")
+		return OpCode::reduceProd_;
+	else if(str == "reduceMin")
+		return OpCode::reduceMin_;
+	else if(str == "reduceMax")
+		return OpCode::reduceMax_;
+	else if(str == "reduceDot")
+		return OpCode::reduceDot_;
+	else if(str == "countEqu")
+		return OpCode::countEqu_;
+	else if(str == "copyRange")
+		return OpCode::copyRange_;
+	else if(str == "fillRange")
+		return OpCode::fillRange_;
+	else if(str == "alloc")
+		return OpCode::alloc_;
+	else if(str == "free")
+		return OpCode::free_;
+	else if(str == "deref")
+		return OpCode::deref_;
 	return std::nullopt;
 }
 
@@ -116,35 +164,136 @@ bool StackIndex::isValid() const
 
 
 
-Processor::Processor(const std::vector<Instruction>& program, size_t stackSize) : program_(program),
-stack_(this, stackSize), FunctionReturnValues_(this, 1024), finished_(false), returningFromFunction_(false)
+size_t FrameLayout::addSlot(const TypeVariant& type, const std::string& name)
 {
-	baseTypes_.insert({"int64", BaseType(sizeof(int64_t))});
-	baseTypes_.insert({"bool", BaseType(sizeof(bool))});
-	baseTypes_.insert({"char", BaseType(sizeof(char))});
-	baseTypes_.insert({"double", BaseType( sizeof(double))});
-	baseTypes_.insert({"void", BaseType(0)});
+	if(validationEnabled(ValidationLevel::basic) && !type.isValid())
+		throw std::invalid_argument("size_t FrameLayout::addSlot(const TypeVariant&, const std::string&) invalid slot type");
+	// same natural layout StructType gives the slots, adding a slot never moves the earlier ones
+	size_t subIndex = elementCount_ == 0 ? 1 : elementCount_;
+	size_t offset = alignUp(end_, type.alignment());
+	types_.push_back(type);
+	names_.push_back(name);
+	indexes_.push_back(subIndex);
+	offsets_.push_back(offset);
+	alignment_ = std::max(alignment_, type.alignment());
+	end_ = offset + type.size();
+	size_ = alignUp(end_, alignment_);
+	elementCount_ = subIndex + type.elementCount();
+	type_ = nullptr;
+	return subIndex;
+}
+
+std::optional<size_t> FrameLayout::slotByIndex(size_t index) const
+{
+	for(size_t slot = 0; slot < indexes_.size(); ++slot)
+	{
+		if(indexes_[slot] == index)
+			return slot;
+	}
+	return std::nullopt;
+}
+
+const StructType& FrameLayout::type() const
+{
+	if(types_.empty())
+		throw std::runtime_error("FrameLayout::type() called on empty FrameLayout");
+	if(type_ == nullptr)
+		type_ = TypeTable::instance().structType(StructType(types_, names_, StructLayout::natural));
+	return *type_;
+}
+
+
+
+Processor::Processor(const std::vector<Instruction>& program, size_t stackSize, bool hugePages) : program_(program),
+stack_(this, stackSize, false, hugePages), nextGeneration_(1), finished_(false), returningFromFunction_(false), tosCount_(0)
+{
+	TypeTable& table = TypeTable::instance();
+	baseTypes_.insert({"int64", table.baseType("int64", sizeof(int64_t))});
+	baseTypes_.insert({"bool", table.baseType("bool", sizeof(bool))});
+	baseTypes_.insert({"char", table.baseType("char", sizeof(char))});
+	baseTypes_.insert({"double", table.baseType("double", sizeof(double))});
+	baseTypes_.insert({"void", table.baseType("void", 0)});
+	int64Type_ = baseTypes_.at("int64");
+	charType_ = baseTypes_.at("char");
+	boolType_ = baseTypes_.at("bool");
+	doubleType_ = baseTypes_.at("double");
 	
 	noBlockingInput_ = false;
 }
 
-Processor::Processor(size_t stackSize) : 
-stack_(this, stackSize), FunctionReturnValues_(this, 1024), finished_(false), returningFromFunction_(false)
+Processor::Processor(size_t stackSize, bool hugePages) : 
+stack_(this, stackSize, false, hugePages), nextGeneration_(1), finished_(false), returningFromFunction_(false), tosCount_(0)
 {
-	baseTypes_.insert({"int64", BaseType(sizeof(int64_t))});
-	baseTypes_.insert({"bool", BaseType(sizeof(bool))});
-	baseTypes_.insert({"char", BaseType(sizeof(char))});
-	baseTypes_.insert({"double", BaseType( sizeof(double))});
-	baseTypes_.insert({"void", BaseType(0)});
+	TypeTable& table = TypeTable::instance();
+	baseTypes_.insert({"int64", table.baseType("int64", sizeof(int64_t))});
+	baseTypes_.insert({"bool", table.baseType("bool", sizeof(bool))});
+	baseTypes_.insert({"char", table.baseType("char", sizeof(char))});
+	baseTypes_.insert({"double", table.baseType("double", sizeof(double))});
+	baseTypes_.insert({"void", table.baseType("void", 0)});
+	int64Type_ = baseTypes_.at("int64");
+	charType_ = baseTypes_.at("char");
+	boolType_ = baseTypes_.at("bool");
+	doubleType_ = baseTypes_.at("double");
 	noBlockingInput_ = false;
 }
 
 
 
-void Processor::functionEntry(size_t argumentsElementCount) 
+void Processor::spillTos()
+{
+	for(size_t i = 0; i < tosCount_; ++i)
+	{
+		uint8_t* data = operands_.push(TypeVariant(tos_[i].type));
+		memcpy(data, tos_[i].data, tos_[i].type->size());
+	}
+	tosCount_ = 0;
+}
+
+const BaseType* Processor::scalarTypeFromEnd(size_t index)
+{
+	if(index < tosCount_)
+		return tos_[tosCount_ - 1 - index].type;
+	const Operand& operand = operands_.fromEnd(index - tosCount_);
+	if(!operand.type().isBaseType() || operand.size() > sizeof(CachedOperand::data))
+		return nullptr;
+	return operand.type().get<const BaseType*>();
+}
+
+uint8_t* Processor::pushScalar(const BaseType* type)
+{
+	if(tosCount_ == 2)
+	{
+		uint8_t* data = operands_.push(TypeVariant(tos_[0].type));
+		memcpy(data, tos_[0].data, tos_[0].type->size());
+		tos_[0] = tos_[1];
+		tosCount_ = 1;
+	}
+	tos_[tosCount_].type = type;
+	return tos_[tosCount_++].data;
+}
+
+const uint8_t* Processor::popScalar()
+{
+	if(tosCount_ != 0)
+		return tos_[--tosCount_].data;
+	const uint8_t* data = operands_.dataFromEnd(0);
+	operands_.pop();
+	return data;
+}
+
+uint8_t* Processor::functionEntry(const FrameLayout& frame) 
 {
-	functionStackStartPositions_.push_back(stack_.elementCount() - argumentsElementCount);
+	functionStackStartPositions_.push_back(stack_.elementCount());
+	frameGenerations_.push_back(nextGeneration_++);
 	stack_.newLevel();
+	if(frame.empty())
+	{
+		frameBases_.push_back(stack_.top());
+		return nullptr;
+	}
+	uint8_t* frameData = stack_.push(ElementInfo(TypeVariant(&frame.type())));
+	frameBases_.push_back(frameData - stack_.data());
+	return frameData;
 }
 
 void Processor::functionExit()
@@ -152,6 +301,13 @@ void Processor::functionExit()
 	if(functionStackStartPositions_.empty())
 		throw std::runtime_error("Processor::functionExit() no function to exit from");
 	functionStackStartPositions_.pop_back();
+	size_t frameBase = frameBases_.back();
+	std::erase_if(borrows_, [&](const Borrow& borrow) // nothing may keep reading the frame being dropped
+	{
+		return borrow.slot ? borrow.target >= frameBase : borrow.source >= frameBase || !borrowValid(borrow);
+	});
+	frameBases_.pop_back();
+	frameGenerations_.pop_back();
 	stack_.popLevel();
 }
 
@@ -170,56 +326,65 @@ std::optional<int64_t> Processor::call_(Instruction&)
 {
 	if(finished_)
 		return std::nullopt;
-	std::optional<Element> lastElemOpt = stack_.wholeElementFromEnd(0);
-	if(!lastElemOpt.has_value())
-		throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) called on incorrect stack stack_.wholeElementFromEnd(0) hasn't value");
-	Element lastElem = lastElemOpt.value();
-	if(!lastElem.type().isFunctionType())
+	spillTos();
+	if(operands_.empty())
+		throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) called on empty operand stack");
+	Operand& funcOperand = operands_.fromEnd(0);
+	if(!funcOperand.type().isFunctionType())
 		throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) called on non-function last stack element");
-	FunctionType func = lastElem.type().get<FunctionType>(); 
+	FunctionType func = funcOperand.type().get<FunctionType>(); 
+	Function* function = *reinterpret_cast<Function**>(operands_.data(funcOperand));
 	const std::vector<TypeVariant>& args = func.argumentsTypes();
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(operands_.size() < args.size() + 1)
+		throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) function called on invalid arguments");
+	if(validationEnabled(ValidationLevel::light))
 	{
 		for(size_t i = 0; i < args.size(); ++i)
 		{
-			std::optional<Element> we = stack_.wholeElementFromEnd(i+1);
-			if(!we.has_value())
-			{
-				throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) function called on invalid arguments");
-			}
-			if(args[i] != we.value().type())
+			if(args[i] != operands_.fromEnd(args.size() - i).type())
 			{
 				throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) function called on invalid arguments");
 			}
 		}
 	}
-	size_t argumentsElementCount = 0;
-	for(const TypeVariant& argType : args)
+	const FrameLayout& frame = function->frame();
+	uint8_t* frameData = functionEntry(frame);
+	for(size_t i = 0; i < args.size(); ++i) // arguments occupy the first slots of the frame
 	{
-		argumentsElementCount += argType.elementCount();
+		Operand& argument = operands_.fromEnd(args.size() - i);
+		if(argument.borrowed()) // the callee reads the caller's value until one of them writes it
+			borrows_.push_back(Borrow{argument.source(), argument.size(), frameBases_.back() + frame.slotOffset(i), true});
+		else
+			memcpy(frameData + frame.slotOffset(i), operands_.data(argument), args[i].size());
 	}
-	functionEntry(argumentsElementCount);
-	uint8_t* elemPtr = stack_.at(lastElem);
-	std::vector<Instruction>& body = **reinterpret_cast<std::vector<Instruction>**>(elemPtr);
-	for(Instruction& inst : body)
+	operands_.pop(args.size() + 1);
+	if(func.returnType().size() != 0) // the callee's ret writes straight into this slot
+	{
+		returnSlots_.push_back(operands_.size());
+		operands_.push(func.returnType());
+	}
+	else
+		returnSlots_.push_back(SIZE_MAX);
+	size_t operandsLevel = saveOperands();
+	for(Instruction& inst : function->body())
 	{
 		execute(inst);
 		if(finished_)
 		{
+			returnSlots_.pop_back();
 			functionExit();
 			return std::nullopt;
 		}
 		if(returningFromFunction_)
-		{
-			returningFromFunction_ = false;
-			functionExit();
-			stack_.push(func.returnType());
-			if(returningValue_.size() != func.returnType().size())
-				throw std::runtime_error("std::optional<int64_t> Processor::call_(Instruction&) invalid return value");
-			memcpy(stack_.atWholeFromEnd(0).value(), returningValue_.data(), returningValue_.size());
 			break;
-		}
 	}
+	bool returned = returningFromFunction_;
+	returningFromFunction_ = false;
+	restoreOperands(operandsLevel);
+	returnSlots_.pop_back();
+	functionExit();
+	if(!returned && func.returnType().size() != 0)
+		operands_.pop();
 	return 0;
 }
 
@@ -227,12 +392,22 @@ std::optional<int64_t> Processor::ret_(Instruction&)
 {
 	if(finished_)
 		return std::nullopt;
-	std::optional<Element> lastElemOpt = stack_.wholeElementFromEnd(0);
-	if(!lastElemOpt.has_value())
-		throw std::runtime_error("std::optional<int64_t> Processor::ret_(Instruction&) called on on incorrect stack");
-	Element lastElem = lastElemOpt.value();
-	returningValue_.resize(lastElem.size());
-	memcpy(returningValue_.data(), stack_.atWholeFromEnd(0).value(), lastElem.size());
+	spillTos();
+	returningFromFunction_ = true;
+	if(returnSlots_.empty() || returnSlots_.back() == SIZE_MAX)
+		return 0;
+	Operand& slot = operands_.at(returnSlots_.back());
+	if(operands_.size() <= returnSlots_.back() + 1)
+		throw std::runtime_error("std::optional<int64_t> Processor::ret_(Instruction&) no return value");
+	Operand& value = operands_.fromEnd(0);
+	if(value.size() != slot.size())
+		throw std::runtime_error("std::optional<int64_t> Processor::ret_(Instruction&) invalid return value");
+	if(validationEnabled(ValidationLevel::light))
+	{
+		if(value.type() != slot.type())
+			throw std::runtime_error("std::optional<int64_t> Processor::ret_(Instruction&) invalid return value type");
+	}
+	memcpy(operands_.data(slot), operandData(value), value.size());
 	return 0;
 }
 
@@ -249,30 +424,141 @@ std::optional<int64_t> Processor::init_(Instruction& instruction)
 	return 0;
 }
 
+const uint8_t* Processor::linkData(const Link& link)
+{
+	if(link.onHeap()) // nothing borrows from the heap
+		return reinterpret_cast<const uint8_t*>(link.offset());
+	if(validationEnabled(ValidationLevel::light))
+	{
+		if(!std::binary_search(frameGenerations_.begin(), frameGenerations_.end(), link.generation()))
+			throw std::runtime_error("const uint8_t* Processor::linkData(const Link&) link outlived its frame");
+		if(link.offset() + TypeTable::instance().size(link.type()) > stack_.top())
+			throw std::runtime_error("const uint8_t* Processor::linkData(const Link&) link points above the stack top");
+	}
+	return readData(link.offset());
+}
+
+uint8_t* Processor::writableLinkData(const Link& link)
+{
+	if(link.onHeap())
+		return reinterpret_cast<uint8_t*>(link.offset());
+	linkData(link);
+	size_t begin = link.offset();
+	size_t end = begin + TypeTable::instance().size(link.type());
+	for(size_t i = 0; i < borrows_.size();)
+	{
+		Borrow borrow = borrows_[i];
+		bool written = (borrow.source < end && begin < borrow.source + borrow.size) ||
+			(borrow.slot && borrow.target < end && begin < borrow.target + borrow.size);
+		if(written && borrowValid(borrow))
+			materialize(borrow);
+		if(written || !borrowValid(borrow))
+			borrows_.erase(borrows_.begin() + i);
+		else
+			++i;
+	}
+	return stack_.data() + begin;
+}
+
+const uint8_t* Processor::readData(size_t position)
+{
+	bool moved = true;
+	while(moved) // the source may itself be an argument slot still borrowing from further up
+	{
+		moved = false;
+		for(const Borrow& borrow : borrows_)
+		{
+			if(borrow.slot && position >= borrow.target && position < borrow.target + borrow.size)
+			{
+				position = borrow.source + (position - borrow.target);
+				moved = true;
+				break;
+			}
+		}
+	}
+	return stack_.data() + position;
+}
+
+const uint8_t* Processor::operandData(Operand& operand)
+{
+	if(operand.borrowed())
+		return readData(operand.source());
+	return operands_.data(operand);
+}
+
+bool Processor::borrowValid(const Borrow& borrow) // operands are popped without notice, so their borrows go stale
+{
+	if(borrow.slot)
+		return true;
+	if(borrow.target >= operands_.size())
+		return false;
+	const Operand& operand = operands_.at(borrow.target);
+	return operand.borrowed() && operand.source() == borrow.source;
+}
+
+void Processor::materialize(const Borrow& borrow)
+{
+	if(borrow.slot)
+	{
+		memcpy(stack_.data() + borrow.target, readData(borrow.source), borrow.size);
+		return;
+	}
+	Operand& operand = operands_.at(borrow.target);
+	memcpy(operands_.data(operand), readData(borrow.source), borrow.size);
+	operands_.detach(operand);
+}
+
+void Processor::borrowOperand(const TypeVariant& type, size_t source)
+{
+	while(!borrows_.empty() && !borrowValid(borrows_.back()))
+		borrows_.pop_back();
+	borrows_.push_back(Borrow{source, type.size(), operands_.size(), false});
+	operands_.borrow(type, source);
+}
+
+void Processor::pushLink(const Link& link)
+{
+	spillTos();
+	uint8_t* linkData = operands_.push(TypeVariant(LinkType::byId(link.type())));
+	new(linkData) Link(link);
+}
+
+std::optional<int64_t> Processor::pushFrameLink(Instruction& instruction)
+{
+	std::vector<Argument>& args = instruction.arguments();
+	if(validationEnabled(ValidationLevel::basic))
+	{
+		if(args.size() != 3 || !std::holds_alternative<PreStackIndex>(args[0]) || !std::holds_alternative<Value>(args[1])
+			|| !std::holds_alternative<int64_t>(std::get<Value>(args[1])) || !std::holds_alternative<TypeVariant>(args[2]))
+			throw std::runtime_error("std::optional<int64_t> Processor::pushFrameLink(Instruction&) called with invalid arguments");
+	}
+	// args: the variable, byte offset of the value from the frame base, link type to the value
+	bool global = std::get<PreStackIndex>(args[0]).isGlobal();
+	size_t offset = (global ? frameBases_.front() : frameBases_.back()) + std::get<int64_t>(std::get<Value>(args[1]));
+	TypeId type = std::get<TypeVariant>(args[2]).get<LinkType>().pointsToId();
+	pushLink(Link(offset, type, global ? frameGenerations_.front() : frameGenerations_.back()));
+	return 0;
+}
+
 std::optional<int64_t> Processor::get_(Instruction& instruction)
 {
 	if(finished_)
 		return std::nullopt;
-	//std::cout << "getting" << std::endl;
 	std::vector<Argument>& args = instruction.arguments();
+	if(args.size() == 3) // resolved by the parser
+		return pushFrameLink(instruction);
 	if(args.size() != 1)
 		throw std::runtime_error("std::optional<int64_t> Processor::get_(Instruction&) called with invalid argument count");
 	if(!std::holds_alternative<PreStackIndex>(args[0]))
 		throw std::runtime_error("std::optional<int64_t> Processor::get_(Instruction&) called with invalid argument");
-	//std::cout << "ready getting01" << std::endl;
-	StackIndex stackIndex(std::get<PreStackIndex>(args[0]), this);
-	//std::cout << "ready getting0" << std::endl;
+	PreStackIndex& preStackIndex = std::get<PreStackIndex>(args[0]);
+	StackIndex stackIndex(preStackIndex, this);
 	std::optional<Element> elemOpt = stack_.element(stackIndex.index());
 	if(!elemOpt.has_value())
 		throw std::runtime_error("std::optional<int64_t> Processor::get_(Instruction&) can't get element");
-	//std::cout << "ready getting" << std::endl;
 	Element& elem = elemOpt.value();
-	Link elemPos = elem.index();
-	LinkType linkType = LinkType();
-	TypeVariant linkVariant(linkType);
-	ElementInfo elemInfo(linkVariant);
-	uint8_t* elemPosD = stack_.push(ElementInfo(TypeVariant(LinkType())));
-	*reinterpret_cast<Link*>(elemPosD) = elemPos;
+	uint32_t generation = preStackIndex.isGlobal() ? frameGenerations_.front() : frameGenerations_.back();
+	pushLink(Link(elem.pos(), TypeTable::instance().intern(elem.type()), generation));
 	return 0;
 }
 
@@ -280,49 +566,22 @@ std::optional<int64_t> Processor::set_(Instruction&)
 {
 	if(finished_)
 		return std::nullopt;
-	std::optional<Element> valueElemOpt = stack_.wholeElementFromEnd(0);
-	std::optional<Element> linkElemOpt = stack_.wholeElementFromEnd(1);
-	if(!valueElemOpt.has_value() || !linkElemOpt.has_value())
+	spillTos();
+	if(operands_.size() < 2)
 		throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) called on invalid arguments in stack");
-	Element valueElem = valueElemOpt.value();
-	Element linkElem = linkElemOpt.value();
-	if(!linkElem.type().isLinkType())
+	Operand& valueOperand = operands_.fromEnd(0);
+	Operand& linkOperand = operands_.fromEnd(1);
+	if(!linkOperand.type().isLinkType())
 		throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) called on invalid link argument");
-	Link* linkElemPos = reinterpret_cast<Link*>(stack_.at(linkElem));
-	size_t linkDataSize;
-	uint8_t* linkDataPtr;
-	if(std::holds_alternative<uint8_t*>(*linkElemPos))
+	const Link& link = *reinterpret_cast<const Link*>(operands_.data(linkOperand));
+	if(validationEnabled(ValidationLevel::light))
 	{
-		linkDataPtr = std::get<uint8_t*>(*linkElemPos);
-		std::optional<TypeVariant> targetTypeOpt = linkElem.type().get<LinkType>().pointsTo();
-		if(!targetTypeOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) called on invalid link pointsTo");
-		TypeVariant targetType = targetTypeOpt.value();
-		linkDataSize = targetType.size();
-		if(getValidationLevel() >= ValidationLevel::light)
-		{
-			if(valueElem.type() != targetType)
-				throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) incopatible link");
-
-		}
+		if(valueOperand.type() != TypeTable::instance().type(link.type()))
+			throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) incopatible link");
 	}
-	else // size_t
-	{
-		std::optional<Element> linkedElementOpt = stack_.element(std::get<size_t>(*linkElemPos));
-		if(!linkedElementOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) invalid link");
-		Element linkedElement = linkedElementOpt.value();
-		linkDataPtr = stack_.at(linkedElement);
-		linkDataSize = linkedElement.type().size();
-		if(getValidationLevel() >= ValidationLevel::light)
-		{
-			if(valueElem.type() != linkedElement.type())
-				throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) incopatible link");
-		}
-	}
-	memcpy(linkDataPtr, stack_.at(valueElem), linkDataSize);
-	stack_.pop();
-	stack_.pop();
+	uint8_t* target = writableLinkData(link); // first, so a value borrowed from the target is copied out before it changes
+	memcpy(target, operandData(valueOperand), TypeTable::instance().size(link.type()));
+	operands_.pop(2);
 	return 0;
 }
 
@@ -330,37 +589,27 @@ std::optional<int64_t> Processor::valfromstlink_(Instruction&)
 {
 	if(finished_)
 		return std::nullopt;
-	std::optional<Element> elemOpt = stack_.wholeElementFromEnd(0);
-	if(!elemOpt.has_value())
+	spillTos();
+	if(operands_.empty())
 		throw std::runtime_error("std::optional<int64_t> Processor::valfromstlink_(Instruction&) called on empty stack");
-	Element elem = elemOpt.value();
-	if(!elem.type().isLinkType())
+	Operand& linkOperand = operands_.fromEnd(0);
+	if(!linkOperand.type().isLinkType())
 		throw std::runtime_error("std::optional<int64_t> Processor::valfromstlink_(Instruction&) last element should be link");
-	Link link = *reinterpret_cast<Link*>(stack_.at(elem));
-	size_t linkDataSize;
-	uint8_t* linkDataPtr;
-	TypeVariant linkType;
-	if(std::holds_alternative<uint8_t*>(link))
-	{
-		linkDataPtr = std::get<uint8_t*>(link);
-		std::optional<TypeVariant> linkTypeOpt = std::get<LinkType>(elem.type()).pointsTo();
-		if(!linkTypeOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) called on invalid link pointsTo");
-		linkType = linkTypeOpt.value();
-		linkDataSize = linkType.size();
-	}
-	else // size_t
+	Link link = *reinterpret_cast<const Link*>(operands_.data(linkOperand));
+	const TypeVariant& linkType = TypeTable::instance().type(link.type());
+	size_t linkDataSize = TypeTable::instance().size(link.type());
+	const uint8_t* linkDataPtr = linkData(link);
+	operands_.pop();
+	if(linkDataSize > borrowThreshold_ && !link.onHeap()) // large aggregates are read through the link until either side is written
 	{
-		std::optional<Element> linkedElementOpt = stack_.element(std::get<size_t>(link));
-		if(!linkedElementOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::set_(Instruction&) invalid link");
-		Element linkedElement = linkedElementOpt.value();
-		linkType = linkedElement.type();
-		linkDataPtr = stack_.at(linkedElement);
-		linkDataSize = linkedElement.type().size();
+		borrowOperand(linkType, link.offset());
+		return 0;
 	}
-	stack_.pop();
-	uint8_t* data = stack_.push(ElementInfo(linkType));
+	uint8_t* data;
+	if(linkType.isBaseType() && linkDataSize <= sizeof(CachedOperand::data))
+		data = pushScalar(linkType.get<const BaseType*>());
+	else
+		data = operands_.push(linkType);
 	memcpy(data, linkDataPtr, linkDataSize);
 	return 0;
 }
@@ -369,81 +618,96 @@ std::optional<int64_t> Processor::getSublink_(Instruction&)
 {
 	if(finished_)
 		return std::nullopt;
-	std::optional<Element> elemOpt = stack_.wholeElementFromEnd(1);
-	std::optional<Element> elemDubIndexOpt = stack_.wholeElementFromEnd(0);
-	if(!elemOpt.has_value() || !elemDubIndexOpt.has_value())
+	spillTos();
+	if(operands_.size() < 2)
 		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) called on incorrect stack");
-	Element elem = elemOpt.value();
-	Element elemDubIndex = elemDubIndexOpt.value();
-	if(!elem.type().isLinkType() || elemDubIndex.type().isBaseType())
+	Operand& linkOperand = operands_.fromEnd(1);
+	Operand& subIndexOperand = operands_.fromEnd(0);
+	if(!linkOperand.type().isLinkType() || !subIndexOperand.type().isBaseType())
 		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect elemnts types");
-	if(elemDubIndex.type() != &baseTypes_["int64"])
+	if(subIndexOperand.type() != int64Type_)
 		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) last element should be int64");
-	Link link = *reinterpret_cast<Link*>(stack_.at(elem));
-	size_t subIndex = *reinterpret_cast<int64_t*>(stack_.at(elemDubIndex));
+	Link link = *reinterpret_cast<const Link*>(operands_.data(linkOperand));
+	size_t subIndex = *reinterpret_cast<const int64_t*>(operands_.data(subIndexOperand));
 
 	if(subIndex == 0)
 	{
-		stack_.pop();
+		operands_.pop();
 		return 0;
 	}
-	TypeVariant linkType;
-	Link subLink;
-	if(std::holds_alternative<uint8_t*>(link))
+	const TypeVariant& linkType = TypeTable::instance().type(link.type());
+	size_t offset;
+	TypeId subType;
+	if(linkType.isArrayType())
 	{
-		std::optional<TypeVariant> linkTypeOpt = elem.type().get<LinkType>().pointsTo();
-		if(!linkTypeOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect elemnt info in stack");
-		linkType = linkTypeOpt.value();
-		if(linkType.isArrayType())
-		{
-			TypeVariant arrType = linkType.get<ArrayType>().elementType();
-			size_t elemSize = arrType.size();
-			size_t elemCount = linkType.get<ArrayType>().count();
-			if(subIndex > elemCount)
-				throw std::out_of_range("std::optional<int64_t> Processor::getSublink_(Instruction&) subIndex > elemCount in array");
-			size_t offset = (subIndex - 1) * elemSize;
-			subLink = std::get<uint8_t*>(link) + offset;
-			stack_.pop();
-			stack_.pop();
-			uint8_t* dataPtr = stack_.push(TypeVariant(LinkType(linkType)));
-			*reinterpret_cast<Link*>(dataPtr) = subLink;
-			return 0;
-		}
-		if(linkType.isStructType())
-		{
-			size_t offset = linkType.get<const StructType*>()->offsetBySize(subIndex);
-			TypeVariant elemType = linkType.get<const StructType*>()->type(subIndex);
-			subLink = std::get<uint8_t*>(link) + offset;
-			stack_.pop();
-			stack_.pop();
-			uint8_t* dataPtr = stack_.push(TypeVariant(LinkType(linkType)));
-			*reinterpret_cast<Link*>(dataPtr) = subLink;
-			return 0;
-		}
-		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect link's pointsTo");
+		const ArrayType& arrayType = linkType.get<ArrayType>();
+		if(subIndex > arrayType.count())
+			throw std::out_of_range("std::optional<int64_t> Processor::getSublink_(Instruction&) subIndex > elemCount in array");
+		offset = arrayType.offset(subIndex);
+		subType = arrayType.elementTypeId();
 	}
-	else if(std::holds_alternative<size_t>(link))
+	else if(linkType.isStructType())
 	{
-		std::optional<Element> linkedElementOpt = stack_.element(std::get<size_t>(link));
-		if(!linkedElementOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect link");
-		Element linkedElement = linkedElementOpt.value();
-		std::optional<Element> subElementOpt = linkedElement.atSubElements(subIndex);
-		if(!subElementOpt.has_value())
-			throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect sub-index");
-		Element subElement = subElementOpt.value();
-		subLink = subElement.index();
-		stack_.pop();
-		stack_.pop();
-		uint8_t* dataPtr = stack_.push(TypeVariant(LinkType()));
-		*reinterpret_cast<Link*>(dataPtr) = subLink;
+		const StructType* structType = linkType.get<const StructType*>();
+		offset = structType->offsetBySize(subIndex);
+		subType = structType->typeId(subIndex);
 	}
 	else
-		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) unknown link type");
+		throw std::runtime_error("std::optional<int64_t> Processor::getSublink_(Instruction&) incorrect link's pointsTo");
+	operands_.pop(2);
+	pushLink(Link(link.offset() + offset, subType, link.generation()));
 	return 0;
 }
 
+std::optional<int64_t> Processor::getSublinks_(Instruction& instruction)
+{
+	if(finished_)
+		return std::nullopt;
+	std::vector<Argument>& args = instruction.arguments();
+	if(validationEnabled(ValidationLevel::basic))
+	{
+		if(args.size() != 1 || !std::holds_alternative<Value>(args[0]) || !std::holds_alternative<int64_t>(std::get<Value>(args[0])))
+			throw std::runtime_error("std::optional<int64_t> Processor::getSublinks_(Instruction&) called with invalid arguments");
+	}
+	size_t indexCount = std::get<int64_t>(std::get<Value>(args[0]));
+	spillTos();
+	if(operands_.size() < indexCount + 1)
+		throw std::runtime_error("std::optional<int64_t> Processor::getSublinks_(Instruction&) called on incorrect stack");
+	Operand& linkOperand = operands_.fromEnd(indexCount);
+	if(!linkOperand.type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::getSublinks_(Instruction&) link expected below the indices");
+	Link link = *reinterpret_cast<const Link*>(operands_.data(linkOperand));
+	size_t offset = link.offset();
+	TypeId type = link.type();
+	bool outOfRange = false;
+	for(size_t i = 0; i < indexCount; ++i) // indices go outermost first, 1-based as in getSublink
+	{
+		const TypeVariant& arrayTypeV = TypeTable::instance().type(type);
+		if(!arrayTypeV.isArrayType())
+			throw std::runtime_error("std::optional<int64_t> Processor::getSublinks_(Instruction&) more indices than array dimensions");
+		const ArrayType& arrayType = arrayTypeV.get<ArrayType>();
+		const Operand& indexOperand = operands_.fromEnd(indexCount - 1 - i);
+		if(validationEnabled(ValidationLevel::light) && indexOperand.type() != int64Type_)
+			throw std::runtime_error("std::optional<int64_t> Processor::getSublinks_(Instruction&) indices should be int64");
+		size_t index = *reinterpret_cast<const int64_t*>(operands_.data(indexOperand)) - 1;
+		outOfRange |= index >= arrayType.count();
+		offset += index * arrayType.elementSize();
+		type = arrayType.elementTypeId();
+	}
+	if(outOfRange) // one check for all dimensions
+		throw std::out_of_range("std::optional<int64_t> Processor::getSublinks_(Instruction&) index out of array bounds");
+	operands_.pop(indexCount + 1);
+	pushLink(Link(offset, type, link.generation()));
+	return 0;
+}
+
+std::optional<int64_t> Processor::getField_(Instruction& instruction)
+{
+	if(finished_)
+		return std::nullopt;
+	return pushFrameLink(instruction);
+}
+
 std::optional<int64_t> Processor::valfromarg_(Instruction& instruction)
 {
 	if(finished_)
@@ -458,27 +722,34 @@ std::optional<int64_t> Processor::valfromarg_(Instruction& instruction)
 	if(std::holds_alternative<int64_t>(val))
 	{
 		int64_t value = std::get<int64_t>(val);
-		uint8_t* addr = stack_.push(ElementInfo(&baseTypes_["int64"]));
+		uint8_t* addr = pushScalar(int64Type_);
 		*reinterpret_cast<int64_t*>(addr) = value;
 		return 0;
 	}
 	if(std::holds_alternative<char>(val))
 	{
 		char value = std::get<char>(val);
-		uint8_t* addr = stack_.push(ElementInfo(&baseTypes_["char"]));
+		uint8_t* addr = pushScalar(charType_);
 		//std::cout << "put " << static_cast<int>(value) << "in stack" << std::endl;
 		*reinterpret_cast<char*>(addr) = value;
 		return 0;
 	}
+	if(std::holds_alternative<bool>(val))
+	{
+		*reinterpret_cast<bool*>(pushScalar(boolType_)) = std::get<bool>(val);
+		return 0;
+	}
+	if(std::holds_alternative<double>(val))
+	{
+		*reinterpret_cast<double*>(pushScalar(doubleType_)) = std::get<double>(val);
+		return 0;
+	}
 	if(std::holds_alternative<Function>(val))
 	{
 		Function& func = std::get<Function>(val);
-		FunctionType& funcType = func.type();
-		TypeVariant& returnType = funcType.returnType();
-		std::vector<TypeVariant>& argumentsTypes = funcType.argumentsTypes();
-		uint8_t* addr = stack_.push(ElementInfo(FunctionType(argumentsTypes, returnType)));
-		std::vector<Instruction>* bodyAddr = &func.body();
-		*reinterpret_cast<std::vector<Instruction>**>(addr) = bodyAddr;
+		spillTos();
+		uint8_t* addr = operands_.push(TypeVariant(func.type()));
+		*reinterpret_cast<Function**>(addr) = &func;
 		return 0;
 	}
 	return 0;
@@ -489,31 +760,30 @@ std::optional<int64_t> Processor::valfromarg_(Instruction& instruction)
 bool Processor::checkCondition(std::vector<Instruction>& condition)
 {
 	stack_.newLevel();
+	size_t operandsLevel = saveOperands();
 	for(Instruction& inst : condition)
 	{
 		if(finished_)
 		{
 			stack_.popLevel();
+			restoreOperands(operandsLevel);
 			return 0;
 		}
 		if(returningFromFunction_)
 		{
 			stack_.popLevel();
+			restoreOperands(operandsLevel);
 			return 0;
 		}
 		execute(inst);
 	}
-	std::optional<Element> condResElemOpt = stack_.wholeElementFromEnd(0);
-	if(!condResElemOpt.has_value())
+	if(operandCount() <= operandsLevel)
 		throw std::runtime_error("std::optional<int64_t> Processor::checkCondition(Instruction&) incorrect condition: no return value");
-	Element condResElem = condResElemOpt.value();
-	if(!condResElem.type().isBaseType())
-		throw std::runtime_error("std::optional<int64_t> Processor::checkCondition(Instruction&) incorrect condition: incorrect return value: should be BaseType bool");
-
-	if(condResElem.type().get<const BaseType*>() != &baseTypes_["bool"])
+	if(scalarTypeFromEnd(0) != boolType_)
 		throw std::runtime_error("std::optional<int64_t> Processor::checkCondition(Instruction&) incorrect condition: incorrect return value: should be BaseType bool");
-	bool res = *reinterpret_cast<bool*>(stack_.at(condResElem));
+	bool res = *reinterpret_cast<const bool*>(popScalar());
 	stack_.popLevel();
+	restoreOperands(operandsLevel);
 	return res;
 }
 
@@ -539,41 +809,49 @@ std::optional<int64_t> Processor::if_(Instruction& instruction)
 	{
 		std::vector<Instruction>& insts = std::get<std::vector<Instruction>>(args[1]);
 		stack_.newLevel();
+		size_t operandsLevel = saveOperands();
 		for(Instruction& inst : insts)
 		{
 			if(returningFromFunction_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return 0;
 			}
 			if(finished_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return std::nullopt;
 			}
 			execute(inst);
 		}
 		stack_.popLevel();
+		restoreOperands(operandsLevel);
 	}
 	if(!condRes && args.size() == 3)
 	{
 		std::vector<Instruction>& insts = std::get<std::vector<Instruction>>(args[2]);
 		stack_.newLevel();
+		size_t operandsLevel = saveOperands();
 		for(Instruction& inst : insts)
 		{
 			if(returningFromFunction_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return 0;
 			}
 			if(finished_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return std::nullopt;
 			}
 			execute(inst);
 		}
 		stack_.popLevel();
+		restoreOperands(operandsLevel);
 	}
 	return 0;
 }
@@ -595,21 +873,25 @@ std::optional<int64_t> Processor::while_(Instruction& instruction)
 	while(condRes)
 	{
 		stack_.newLevel();
+		size_t operandsLevel = saveOperands();
 		for(Instruction& inst : body)
 		{
 			if(returningFromFunction_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return 0;
 			}
 			if(finished_)
 			{
 				stack_.popLevel();
+				restoreOperands(operandsLevel);
 				return std::nullopt;
 			}
 			execute(inst);
 		}
 		stack_.popLevel();
+		restoreOperands(operandsLevel);
 		condRes = checkCondition(condition);
 		if(returningFromFunction_)
 			return 0;
@@ -630,82 +912,369 @@ std::optional<int64_t> Processor::runInstsVec_(Instruction& instruction)
 		throw std::runtime_error("std::optional<int64_t> Processor::runInstsVec_(Instruction&) incorrect argument type");
 	std::vector<Instruction>& body = std::get<std::vector<Instruction>>(args[0]);
 	stack_.newLevel();
+	size_t operandsLevel = saveOperands();
 	for(Instruction& inst : body)
 	{
 		if(returningFromFunction_)
 		{
 			stack_.popLevel();
+			restoreOperands(operandsLevel);
 			return 0;
 		}
 		if(finished_)
 		{
 			stack_.popLevel();
+			restoreOperands(operandsLevel);
 			return std::nullopt;
 		}
 		execute(inst);
 	}
 	stack_.popLevel();
+	restoreOperands(operandsLevel);
 	return 0;
 }
 
-std::optional<int64_t> Processor::mathOper(int64_t(*operFunc)(int64_t a, int64_t b))
+std::optional<int64_t> Processor::arrayOper(ElementwiseOp op)
 {
-	std::optional<Element> operAElemOpt = stack_.wholeElementFromEnd(1);
-	std::optional<Element> operBElemOpt = stack_.wholeElementFromEnd(0);
-	if(!operAElemOpt.has_value() || !operBElemOpt.has_value())
-		throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*operFunc)(int64_t a, int64_t b)) invalid stack: can't get value");
-	Element operAElem = operAElemOpt.value();
-	Element operBElem = operBElemOpt.value();
-	if(!operAElem.type().isBaseType() || !operBElem.type().isBaseType())
-		throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*operFunc)(int64_t a, int64_t b)) invalid argumets types");
-	const BaseType* operAType = operAElem.type().get<const BaseType*>();
-	const BaseType* operBType = operBElem.type().get<const BaseType*>();
-	if(operAType == &baseTypes_["int64"] && operBType == &baseTypes_["int64"])
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 3)
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayOper(ElementwiseOp) called on invalid arguments in stack");
+	for(size_t i = 0; i < 3; ++i)
+	{
+		if(!operands_.fromEnd(i).type().isLinkType())
+			throw std::runtime_error("std::optional<int64_t> Processor::arrayOper(ElementwiseOp) arguments should be links");
+	}
+	Link result = *reinterpret_cast<const Link*>(operands_.dataFromEnd(2));
+	Link a = *reinterpret_cast<const Link*>(operands_.dataFromEnd(1));
+	Link b = *reinterpret_cast<const Link*>(operands_.dataFromEnd(0));
+	const TypeVariant& type = TypeTable::instance().type(a.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayOper(ElementwiseOp) arguments should link arrays");
+	if(b.type() != a.type() || result.type() != a.type()) // a shorter array would be overrun, so this is checked at every level
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayOper(ElementwiseOp) arrays of different types");
+	const ArrayType& array = type.get<ArrayType>();
+	const TypeVariant& elementType = array.elementType();
+	uint8_t* resultData = writableLinkData(result); // first, so borrows of the result are copied out before it changes
+	const uint8_t* aData = linkData(a);
+	const uint8_t* bData = linkData(b);
+	if(elementType == TypeVariant(int64Type_))
+		elementwise(op, reinterpret_cast<const int64_t*>(aData), reinterpret_cast<const int64_t*>(bData), reinterpret_cast<int64_t*>(resultData), array.count());
+	else if(elementType == TypeVariant(doubleType_))
+		elementwise(op, reinterpret_cast<const double*>(aData), reinterpret_cast<const double*>(bData), reinterpret_cast<double*>(resultData), array.count());
+	else
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayOper(ElementwiseOp) arrays should be of int64 or double");
+	operands_.pop(3);
+	return 0;
+}
+
+std::optional<int64_t> Processor::arrayCompare(CompareOp op)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 3)
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) called on invalid arguments in stack");
+	for(size_t i = 0; i < 3; ++i)
+	{
+		if(!operands_.fromEnd(i).type().isLinkType())
+			throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) arguments should be links");
+	}
+	Link mask = *reinterpret_cast<const Link*>(operands_.dataFromEnd(2));
+	Link a = *reinterpret_cast<const Link*>(operands_.dataFromEnd(1));
+	Link b = *reinterpret_cast<const Link*>(operands_.dataFromEnd(0));
+	const TypeVariant& type = TypeTable::instance().type(a.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) arguments should link arrays");
+	const ArrayType& array = type.get<ArrayType>();
+	if(b.type() != a.type()) // a shorter array would be overrun, so this is checked at every level
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) arrays of different types");
+	const TypeVariant& maskType = TypeTable::instance().type(mask.type());
+	if(!maskType.isArrayType() || maskType.get<ArrayType>().count() != array.count() || maskType.get<ArrayType>().elementType() != TypeVariant(boolType_))
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) result should be a bool array of the same length");
+	const TypeVariant& elementType = array.elementType();
+	bool* maskData = reinterpret_cast<bool*>(writableLinkData(mask));
+	const uint8_t* aData = linkData(a);
+	const uint8_t* bData = linkData(b);
+	if(elementType == TypeVariant(int64Type_))
+		compareMask(op, reinterpret_cast<const int64_t*>(aData), reinterpret_cast<const int64_t*>(bData), maskData, array.count());
+	else if(elementType == TypeVariant(doubleType_))
+		compareMask(op, reinterpret_cast<const double*>(aData), reinterpret_cast<const double*>(bData), maskData, array.count());
+	else
+		throw std::runtime_error("std::optional<int64_t> Processor::arrayCompare(CompareOp) arrays should be of int64 or double");
+	operands_.pop(3);
+	return 0;
+}
+
+static bool reassociates(const Instruction& instruction) // reduce instructions written with :fast
+{
+	const std::vector<Argument>& args = instruction.arguments();
+	return args.size() == 1 && std::holds_alternative<Value>(args[0]) && std::holds_alternative<bool>(std::get<Value>(args[0])) && std::get<bool>(std::get<Value>(args[0]));
+}
+
+std::optional<int64_t> Processor::reduceOper(Instruction& instruction, ReduceOp op)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.empty() || !operands_.fromEnd(0).type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::reduceOper(Instruction&, ReduceOp) last element should be link");
+	Link link = *reinterpret_cast<const Link*>(operands_.dataFromEnd(0));
+	const TypeVariant& type = TypeTable::instance().type(link.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("std::optional<int64_t> Processor::reduceOper(Instruction&, ReduceOp) link should point to an array");
+	const ArrayType& array = type.get<ArrayType>();
+	const TypeVariant& elementType = array.elementType();
+	const uint8_t* data = linkData(link);
+	operands_.pop();
+	if(elementType == TypeVariant(int64Type_))
+		*reinterpret_cast<int64_t*>(pushScalar(int64Type_)) = reduce(op, reinterpret_cast<const int64_t*>(data), array.count());
+	else if(elementType == TypeVariant(charType_))
+		*reinterpret_cast<char*>(pushScalar(charType_)) = reduce(op, reinterpret_cast<const char*>(data), array.count());
+	else if(elementType == TypeVariant(doubleType_))
+		*reinterpret_cast<double*>(pushScalar(doubleType_)) = reduce(op, reinterpret_cast<const double*>(data), array.count(), reassociates(instruction));
+	else
+		throw std::runtime_error("std::optional<int64_t> Processor::reduceOper(Instruction&, ReduceOp) array should be of int64, char or double");
+	return 0;
+}
+
+std::optional<int64_t> Processor::dotOper(Instruction& instruction)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 2 || !operands_.fromEnd(0).type().isLinkType() || !operands_.fromEnd(1).type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::dotOper(Instruction&) arguments should be links");
+	Link a = *reinterpret_cast<const Link*>(operands_.dataFromEnd(1));
+	Link b = *reinterpret_cast<const Link*>(operands_.dataFromEnd(0));
+	const TypeVariant& type = TypeTable::instance().type(a.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("std::optional<int64_t> Processor::dotOper(Instruction&) links should point to arrays");
+	if(b.type() != a.type()) // unconditional, the kernels read a's count of a's elements from both
+		throw std::runtime_error("std::optional<int64_t> Processor::dotOper(Instruction&) arrays of different types");
+	const ArrayType& array = type.get<ArrayType>();
+	const TypeVariant& elementType = array.elementType();
+	const uint8_t* aData = linkData(a);
+	const uint8_t* bData = linkData(b);
+	operands_.pop(2);
+	if(elementType == TypeVariant(int64Type_))
+		*reinterpret_cast<int64_t*>(pushScalar(int64Type_)) = dot(reinterpret_cast<const int64_t*>(aData), reinterpret_cast<const int64_t*>(bData), array.count());
+	else if(elementType == TypeVariant(charType_))
+		*reinterpret_cast<char*>(pushScalar(charType_)) = dot(reinterpret_cast<const char*>(aData), reinterpret_cast<const char*>(bData), array.count());
+	else if(elementType == TypeVariant(doubleType_))
+		*reinterpret_cast<double*>(pushScalar(doubleType_)) = dot(reinterpret_cast<const double*>(aData), reinterpret_cast<const double*>(bData), array.count(), reassociates(instruction));
+	else
+		throw std::runtime_error("std::optional<int64_t> Processor::dotOper(Instruction&) arrays should be of int64, char or double");
+	return 0;
+}
+
+std::optional<int64_t> Processor::countOper()
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 2 || !operands_.fromEnd(1).type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::countOper() invalid arguments in stack");
+	Link link = *reinterpret_cast<const Link*>(operands_.dataFromEnd(1));
+	const TypeVariant& type = TypeTable::instance().type(link.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("std::optional<int64_t> Processor::countOper() link should point to an array");
+	const ArrayType& array = type.get<ArrayType>();
+	const TypeVariant& elementType = array.elementType();
+	if(operands_.fromEnd(0).type() != elementType) // unconditional, the value is read as an element
+		throw std::runtime_error("std::optional<int64_t> Processor::countOper() value and array element types differ");
+	const uint8_t* data = linkData(link);
+	const uint8_t* value = operands_.dataFromEnd(0);
+	size_t found;
+	if(elementType == TypeVariant(int64Type_))
+		found = countEqual(reinterpret_cast<const int64_t*>(data), *reinterpret_cast<const int64_t*>(value), array.count());
+	else if(elementType == TypeVariant(charType_))
+		found = countEqual(reinterpret_cast<const char*>(data), *reinterpret_cast<const char*>(value), array.count());
+	else if(elementType == TypeVariant(doubleType_))
+		found = countEqual(reinterpret_cast<const double*>(data), *reinterpret_cast<const double*>(value), array.count());
+	else
+		throw std::runtime_error("std::optional<int64_t> Processor::countOper() array should be of int64, char or double");
+	operands_.pop(2);
+	*reinterpret_cast<int64_t*>(pushScalar(int64Type_)) = static_cast<int64_t>(found);
+	return 0;
+}
+
+size_t Processor::checkedRange(const Link& link, size_t startIndex, size_t countIndex)
+{
+	const TypeVariant& type = TypeTable::instance().type(link.type());
+	if(!type.isArrayType())
+		throw std::runtime_error("size_t Processor::checkedRange(const Link&, size_t, size_t) link should point to an array");
+	if(operands_.fromEnd(startIndex).type() != int64Type_ || operands_.fromEnd(countIndex).type() != int64Type_)
+		throw std::runtime_error("size_t Processor::checkedRange(const Link&, size_t, size_t) start and count should be int64");
+	const ArrayType& array = type.get<ArrayType>();
+	int64_t start = *reinterpret_cast<const int64_t*>(operands_.dataFromEnd(startIndex));
+	int64_t count = *reinterpret_cast<const int64_t*>(operands_.dataFromEnd(countIndex));
+	if(start < 1 || count < 0 || static_cast<uint64_t>(start - 1) + static_cast<uint64_t>(count) > array.count())
+		throw std::out_of_range("size_t Processor::checkedRange(const Link&, size_t, size_t) range out of array");
+	return (start - 1) * array.elementSize();
+}
+
+std::optional<int64_t> Processor::copyRange_(Instruction&)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 5 || !operands_.fromEnd(4).type().isLinkType() || !operands_.fromEnd(2).type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::copyRange_(Instruction&) called on invalid arguments in stack");
+	Link destination = *reinterpret_cast<const Link*>(operands_.dataFromEnd(4));
+	Link source = *reinterpret_cast<const Link*>(operands_.dataFromEnd(2));
+	size_t destinationOffset = checkedRange(destination, 3, 0);
+	size_t sourceOffset = checkedRange(source, 1, 0);
+	const ArrayType& destinationArray = TypeTable::instance().type(destination.type()).get<ArrayType>();
+	if(destinationArray.elementTypeId() != TypeTable::instance().type(source.type()).get<ArrayType>().elementTypeId())
+		throw std::runtime_error("std::optional<int64_t> Processor::copyRange_(Instruction&) arrays of different element types");
+	size_t bytes = *reinterpret_cast<const int64_t*>(operands_.dataFromEnd(0)) * destinationArray.elementSize();
+	uint8_t* destinationData = writableLinkData(destination); // first, so borrows of the destination are copied out before it changes
+	const uint8_t* sourceData = linkData(source);
+	memmove(destinationData + destinationOffset, sourceData + sourceOffset, bytes);
+	operands_.pop(5);
+	return 0;
+}
+
+std::optional<int64_t> Processor::fillRange_(Instruction&)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.size() < 4 || !operands_.fromEnd(3).type().isLinkType())
+		throw std::runtime_error("std::optional<int64_t> Processor::fillRange_(Instruction&) called on invalid arguments in stack");
+	Link link = *reinterpret_cast<const Link*>(operands_.dataFromEnd(3));
+	size_t offset = checkedRange(link, 2, 1);
+	const ArrayType& array = TypeTable::instance().type(link.type()).get<ArrayType>();
+	Operand& value = operands_.fromEnd(0);
+	if(value.type() != array.elementType())
+		throw std::runtime_error("std::optional<int64_t> Processor::fillRange_(Instruction&) value and array element types differ");
+	size_t count = *reinterpret_cast<const int64_t*>(operands_.dataFromEnd(1));
+	size_t elementSize = array.elementSize();
+	uint8_t* data = writableLinkData(link) + offset;
+	const uint8_t* valueData = operandData(value);
+	if(count != 0)
+	{
+		if(elementSize == 1)
+			memset(data, *valueData, count);
+		else
+		{
+			memcpy(data, valueData, value.size());
+			for(size_t filled = 1; filled < count; filled *= 2) // doubles the filled prefix, so log2(count) memcpy calls
+				memcpy(data + filled * elementSize, data, std::min(filled, count - filled) * elementSize);
+		}
+	}
+	operands_.pop(4);
+	return 0;
+}
+
+std::optional<int64_t> Processor::alloc_(Instruction& instruction)
+{
+	if(finished_)
+		return std::nullopt;
+	std::vector<Argument>& args = instruction.arguments();
+	if(validationEnabled(ValidationLevel::basic))
+	{
+		if(args.empty() || args.size() > 2 || !std::holds_alternative<TypeVariant>(args[0]))
+			throw std::runtime_error("std::optional<int64_t> Processor::alloc_(Instruction&) called with invalid arguments");
+	}
+	const TypeVariant& type = std::get<TypeVariant>(args[0]);
+	uint8_t* value = args.size() == 2 ? stack_.regionAllocate(type.size()) : heap_.allocate(type.size()); // alloc:region adds Value(true)
+	spillTos();
+	uint8_t* data = operands_.push(TypeVariant(PointerType(type)));
+	memcpy(data, &value, sizeof(value));
+	return 0;
+}
+
+std::optional<int64_t> Processor::free_(Instruction&)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.empty() || !operands_.fromEnd(0).type().isPointerType())
+		throw std::runtime_error("std::optional<int64_t> Processor::free_(Instruction&) last element should be pointer");
+	uint8_t* value;
+	memcpy(&value, operands_.dataFromEnd(0), sizeof(value));
+	if(validationEnabled(ValidationLevel::basic) && (stack_.regionOwns(value) || stack_.regionReleased(value)))
+		throw std::runtime_error("std::optional<int64_t> Processor::free_(Instruction&) region values are freed with their level");
+	heap_.deallocate(value, operands_.fromEnd(0).type().get<PointerType>().pointerType().size());
+	operands_.pop();
+	return 0;
+}
+
+std::optional<int64_t> Processor::deref_(Instruction&)
+{
+	if(finished_)
+		return std::nullopt;
+	spillTos();
+	if(operands_.empty() || !operands_.fromEnd(0).type().isPointerType())
+		throw std::runtime_error("std::optional<int64_t> Processor::deref_(Instruction&) last element should be pointer");
+	uint8_t* value;
+	memcpy(&value, operands_.dataFromEnd(0), sizeof(value));
+	if(value == nullptr)
+		throw std::runtime_error("std::optional<int64_t> Processor::deref_(Instruction&) null pointer");
+	if(validationEnabled(ValidationLevel::light) && stack_.regionReleased(value))
+		throw std::runtime_error("std::optional<int64_t> Processor::deref_(Instruction&) region value was released with its level");
+	TypeId type = operands_.fromEnd(0).type().get<PointerType>().pointerTypeId();
+	operands_.pop();
+	pushLink(Link(reinterpret_cast<size_t>(value), type, Link::heapGeneration));
+	return 0;
+}
+
+std::optional<int64_t> Processor::mathOper(int64_t(*operFunc)(int64_t a, int64_t b), double(*doubleFunc)(double a, double b))
+{
+	if(operandCount() < 2)
+		throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*)(int64_t, int64_t), double(*)(double, double)) invalid stack: can't get value");
+	const BaseType* operAType = scalarTypeFromEnd(1);
+	const BaseType* operBType = scalarTypeFromEnd(0);
+	if(operAType == nullptr || operBType == nullptr)
+		throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*)(int64_t, int64_t), double(*)(double, double)) invalid argumets types");
+	if(operAType == int64Type_ && operBType == int64Type_)
 	{
-		int64_t operA = *reinterpret_cast<int64_t*>( stack_.at(operAElem));
-		int64_t operB = *reinterpret_cast<int64_t*>( stack_.at(operBElem));
-		stack_.pop();
-		stack_.pop();
+		int64_t operB = *reinterpret_cast<const int64_t*>(popScalar());
+		int64_t operA = *reinterpret_cast<const int64_t*>(popScalar());
 		int64_t res = operFunc(operA, operB);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["int64"])));
+		uint8_t* resAddr = pushScalar(operAType);
 		*reinterpret_cast<int64_t*>(resAddr) = res;
 		return 0;
 	}
-	if(operAType == &baseTypes_["char"] && operBType == &baseTypes_["char"])
+	if(operAType == charType_ && operBType == charType_)
 	{
-		char operA = *reinterpret_cast<char*>( stack_.at(operAElem));
-		char operB = *reinterpret_cast<char*>( stack_.at(operBElem));
-		stack_.pop();
-		stack_.pop();
+		char operB = *reinterpret_cast<const char*>(popScalar());
+		char operA = *reinterpret_cast<const char*>(popScalar());
 		char res = operFunc(operA, operB);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["char"])));
+		uint8_t* resAddr = pushScalar(operAType);
 		*reinterpret_cast<char*>(resAddr) = res;
 		return 0;
 	}
-	throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*operFunc)(int64_t a, int64_t b)) incorrect argumets types");
+	if(operAType == doubleType_ && operBType == doubleType_ && doubleFunc != nullptr)
+	{
+		double operB = *reinterpret_cast<const double*>(popScalar());
+		double operA = *reinterpret_cast<const double*>(popScalar());
+		double res = doubleFunc(operA, operB);
+		uint8_t* resAddr = pushScalar(operAType);
+		*reinterpret_cast<double*>(resAddr) = res;
+		return 0;
+	}
+	throw std::runtime_error("std::optional<int64_t> Processor::mathOper(int64_t(*)(int64_t, int64_t), double(*)(double, double)) incorrect argumets types");
 	return 0;
 }
 
 std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a, bool b))
 {
-	std::optional<Element> operAElemOpt = stack_.wholeElementFromEnd(1);
-	std::optional<Element> operBElemOpt = stack_.wholeElementFromEnd(0);
-	if(!operAElemOpt.has_value() || !operBElemOpt.has_value())
+	if(operandCount() < 2)
 		throw std::runtime_error("std::optional<int64_t> Processor::logicOper(bool(*operFunc)(int64_t a, int64_t b)) invalid stack: can't get value");
-	Element operAElem = operAElemOpt.value();
-	Element operBElem = operBElemOpt.value();
-	if(!operAElem.type().isBaseType() || !operBElem.type().isBaseType())
+	const BaseType* operAType = scalarTypeFromEnd(1);
+	const BaseType* operBType = scalarTypeFromEnd(0);
+	if(operAType == nullptr || operBType == nullptr)
 		throw std::runtime_error("std::optional<int64_t> Processor::logicOper(bool(*operFunc)(int64_t a, int64_t b)) invalid argumets types");
-	const BaseType* operAType = operAElem.type().get<const BaseType*>();
-	const BaseType* operBType = operBElem.type().get<const BaseType*>();
-	if(operAType == &baseTypes_["bool"] && operBType == &baseTypes_["bool"])
+	if(operAType == boolType_ && operBType == boolType_)
 	{
-		bool operA = *reinterpret_cast<bool*>( stack_.at(operAElem));
-		bool operB = *reinterpret_cast<bool*>( stack_.at(operBElem));
-		stack_.pop();
-		stack_.pop();
+		bool operB = *reinterpret_cast<const bool*>(popScalar());
+		bool operA = *reinterpret_cast<const bool*>(popScalar());
 		bool res = operFunc(operA, operB);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["int64"])));
+		uint8_t* resAddr = pushScalar(operAType);
 		*reinterpret_cast<bool*>(resAddr) = res;
 		return 0;
 	}
@@ -715,19 +1284,16 @@ std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a, bool b))
 
 std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a))
 {
-	std::optional<Element> operElemOpt = stack_.wholeElementFromEnd(0);
-	if(!operElemOpt.has_value())
+	if(operandCount() < 1)
 		throw std::runtime_error("std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a)) invalid stack: can't get value");
-	Element operElem = operElemOpt.value();
-	if(!operElem.type().isBaseType())
+	const BaseType* operType = scalarTypeFromEnd(0);
+	if(operType == nullptr)
 		throw std::runtime_error("std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a)) invalid argumets types");
-	const BaseType* operType = operElem.type().get<const BaseType*>();
-	if(operType == &baseTypes_["bool"])
+	if(operType == boolType_)
 	{
-		bool oper = *reinterpret_cast<bool*>( stack_.at(operElem));
-		stack_.pop();
+		bool oper = *reinterpret_cast<const bool*>(popScalar());
 		bool res = operFunc(oper);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["bool"])));
+		uint8_t* resAddr = pushScalar(operType);
 		*reinterpret_cast<bool*>(resAddr) = res;
 		return 0;
 	}
@@ -735,61 +1301,122 @@ std::optional<int64_t> Processor::logicOper(bool(*operFunc)(bool a))
 	return 0;
 }
 
-std::optional<int64_t> Processor::compareOper(bool(*operFunc)(int64_t a, int64_t b))
+const Processor::ValueRanges& Processor::valueRanges(const TypeVariant& type)
 {
-	std::optional<Element> operAElemOpt = stack_.wholeElementFromEnd(1);
-	std::optional<Element> operBElemOpt = stack_.wholeElementFromEnd(0);
-	if(!operAElemOpt.has_value() || !operBElemOpt.has_value())
-		throw std::runtime_error("std::optional<int64_t> Processor::compareOper(bool(*operFunc)(int64_t a, int64_t b)) invalid stack: can't get value");
-	Element operAElem = operAElemOpt.value();
-	Element operBElem = operBElemOpt.value();
-	if(!operAElem.type().isBaseType() || !operBElem.type().isBaseType())
-		throw std::runtime_error("std::optional<int64_t> Processor::compareOper(bool(*operFunc)(int64_t a, int64_t b)) invalid argumets types");
-	const BaseType* operAType = operAElem.type().get<const BaseType*>();
-	const BaseType* operBType = operBElem.type().get<const BaseType*>();
-	if(operAType == &baseTypes_["int64"] && operBType == &baseTypes_["int64"])
+	std::unordered_map<TypeId, ValueRanges>::iterator it = valueRanges_.find(type.id());
+	if(it == valueRanges_.end())
 	{
-		int64_t operA = *reinterpret_cast<int64_t*>( stack_.at(operAElem));
-		int64_t operB = *reinterpret_cast<int64_t*>( stack_.at(operBElem));
-		stack_.pop();
-		stack_.pop();
+		it = valueRanges_.emplace(type.id(), ValueRanges()).first;
+		type.valueRanges(it->second.bytes, doubleType_, it->second.doubles);
+	}
+	return it->second;
+}
+
+std::optional<int64_t> Processor::aggregateCompare(CompareOp op, bool(*operFunc)(int64_t a, int64_t b))
+{
+	spillTos();
+	Operand& operA = operands_.fromEnd(1);
+	Operand& operB = operands_.fromEnd(0);
+	if(operA.type() != operB.type())
+		throw std::runtime_error("std::optional<int64_t> Processor::aggregateCompare(CompareOp, bool(*)(int64_t, int64_t)) operands of different types");
+	const uint8_t* dataA = operandData(operA);
+	const uint8_t* dataB = operandData(operB);
+	int order = 0; // sign of a - b, for equality only 0 or not
+	if(op == CompareOp::equ || op == CompareOp::neq)
+	{
+		const ValueRanges& ranges = valueRanges(operA.type());
+		for(const std::pair<size_t, size_t>& range : ranges.bytes) // padding never takes part
+		{
+			order = memcmp(dataA + range.first, dataB + range.first, range.second);
+			if(order != 0)
+				break;
+		}
+		// doubles by value, so -0.0 equals 0.0 and NaN equals nothing
+		for(size_t run = 0; order == 0 && run < ranges.doubles.size(); ++run)
+		{
+			for(size_t offset = ranges.doubles[run].first; offset < ranges.doubles[run].first + ranges.doubles[run].second; offset += sizeof(double))
+			{
+				double a, b;
+				memcpy(&a, dataA + offset, sizeof(double));
+				memcpy(&b, dataB + offset, sizeof(double));
+				if(a != b)
+				{
+					order = 1;
+					break;
+				}
+			}
+		}
+	}
+	else
+	{
+		const TypeVariant& type = operA.type();
+		if(!type.isArrayType() || type.get<ArrayType>().elementType() != TypeVariant(charType_))
+			throw std::runtime_error("std::optional<int64_t> Processor::aggregateCompare(CompareOp, bool(*)(int64_t, int64_t)) only char arrays are ordered");
+		order = memcmp(dataA, dataB, operA.size()); // lexicographic, bytes compared as unsigned like strcmp
+	}
+	operands_.pop(2);
+	*reinterpret_cast<bool*>(pushScalar(boolType_)) = operFunc(order, 0);
+	return 0;
+}
+
+std::optional<int64_t> Processor::compareOper(CompareOp op, bool(*operFunc)(int64_t a, int64_t b), bool(*doubleFunc)(double a, double b))
+{
+	if(operandCount() < 2)
+		throw std::runtime_error("std::optional<int64_t> Processor::compareOper(CompareOp, bool(*)(int64_t, int64_t), bool(*)(double, double)) invalid stack: can't get value");
+	const BaseType* operAType = scalarTypeFromEnd(1);
+	const BaseType* operBType = scalarTypeFromEnd(0);
+	if(operAType == nullptr && operBType == nullptr)
+		return aggregateCompare(op, operFunc);
+	if(operAType == nullptr || operBType == nullptr)
+		throw std::runtime_error("std::optional<int64_t> Processor::compareOper(CompareOp, bool(*)(int64_t, int64_t), bool(*)(double, double)) invalid argumets types");
+	if(operAType == int64Type_ && operBType == int64Type_)
+	{
+		int64_t operB = *reinterpret_cast<const int64_t*>(popScalar());
+		int64_t operA = *reinterpret_cast<const int64_t*>(popScalar());
 		bool res = operFunc(operA, operB);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["bool"])));
+		uint8_t* resAddr = pushScalar(boolType_);
 		*reinterpret_cast<bool*>(resAddr) = res;
 		return 0;
 	}
-	if(operAType == &baseTypes_["char"] && operBType == &baseTypes_["char"])
+	if(operAType == charType_ && operBType == charType_)
 	{
-		char operA = *reinterpret_cast<char*>( stack_.at(operAElem));
-		char operB = *reinterpret_cast<char*>( stack_.at(operBElem));
-		stack_.pop();
-		stack_.pop();
+		char operB = *reinterpret_cast<const char*>(popScalar());
+		char operA = *reinterpret_cast<const char*>(popScalar());
 		bool res = operFunc(operA, operB);
-		uint8_t* resAddr = stack_.push(ElementInfo(TypeVariant(&baseTypes_["bool"])));
-		*reinterpret_cast<char*>(resAddr) = res;
+		uint8_t* resAddr = pushScalar(boolType_);
+		*reinterpret_cast<bool*>(resAddr) = res;
 		return 0;
 	}
-	throw std::runtime_error("std::optional<int64_t> Processor::compareOper(bool(*operFunc)(int64_t a, int64_t b)) incorrect argumets types");
+	if(operAType == doubleType_ && operBType == doubleType_)
+	{
+		double operB = *reinterpret_cast<const double*>(popScalar());
+		double operA = *reinterpret_cast<const double*>(popScalar());
+		bool res = doubleFunc(operA, operB);
+		uint8_t* resAddr = pushScalar(boolType_);
+		*reinterpret_cast<bool*>(resAddr) = res;
+		return 0;
+	}
+	throw std::runtime_error("std::optional<int64_t> Processor::compareOper(CompareOp, bool(*)(int64_t, int64_t), bool(*)(double, double)) incorrect argumets types");
 	return 0;
 }
 
 
 std::optional<int64_t> Processor::add_(Instruction&)
 {
-	return mathOper([](int64_t a, int64_t b){ return a + b; });
+	return mathOper([](int64_t a, int64_t b){ return a + b; }, [](double a, double b){ return a + b; });
 }
 
 std::optional<int64_t> Processor::sub_(Instruction&)
 {
-	return mathOper([](int64_t a, int64_t b){ return a - b; });
+	return mathOper([](int64_t a, int64_t b){ return a - b; }, [](double a, double b){ return a - b; });
 }
 std::optional<int64_t> Processor::mul_(Instruction&)
 {
-	return mathOper([](int64_t a, int64_t b){ return a * b; });
+	return mathOper([](int64_t a, int64_t b){ return a * b; }, [](double a, double b){ return a * b; });
 }
 std::optional<int64_t> Processor::div_(Instruction&)
 {
-	return mathOper([](int64_t a, int64_t b){ return a / b; });
+	return mathOper([](int64_t a, int64_t b){ return a / b; }, [](double a, double b){ return a / b; });
 }
 std::optional<int64_t> Processor::mod_(Instruction&)
 {
@@ -820,27 +1447,69 @@ std::optional<int64_t> Processor::not_(Instruction&)
 
 std::optional<int64_t> Processor::ls_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a < b; });
+	return compareOper(CompareOp::ls, [](int64_t a, int64_t b){ return a < b; }, [](double a, double b){ return a < b; });
 }
 std::optional<int64_t> Processor::leq_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a <= b; });
+	return compareOper(CompareOp::leq, [](int64_t a, int64_t b){ return a <= b; }, [](double a, double b){ return a <= b; });
 }
 std::optional<int64_t> Processor::bg_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a > b; });
+	return compareOper(CompareOp::bg, [](int64_t a, int64_t b){ return a > b; }, [](double a, double b){ return a > b; });
 }
 std::optional<int64_t> Processor::beq_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a >= b; });
+	return compareOper(CompareOp::beq, [](int64_t a, int64_t b){ return a >= b; }, [](double a, double b){ return a >= b; });
 }
 std::optional<int64_t> Processor::equ_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a == b; });
+	return compareOper(CompareOp::equ, [](int64_t a, int64_t b){ return a == b; }, [](double a, double b){ return a == b; });
 }
 std::optional<int64_t> Processor::neq_(Instruction&)
 {
-	return compareOper([](int64_t a, int64_t b){ return a != b; });
+	return compareOper(CompareOp::neq, [](int64_t a, int64_t b){ return a != b; }, [](double a, double b){ return a != b; });
+}
+
+template<> const BaseType* Processor::scalarType<int64_t>() const { return int64Type_; }
+template<> const BaseType* Processor::scalarType<char>() const { return charType_; }
+template<> const BaseType* Processor::scalarType<double>() const { return doubleType_; }
+
+struct ShiftLeft
+{
+	template<typename T> T operator()(T a, T b) const { return a << b; }
+};
+
+struct ShiftRight
+{
+	template<typename T> T operator()(T a, T b) const { return a >> b; }
+};
+
+template<typename T, typename Oper>
+std::optional<int64_t> Processor::typedMathOper()
+{
+	if(validationEnabled(ValidationLevel::light))
+	{
+		if(operandCount() < 2 || scalarTypeFromEnd(1) != scalarType<T>() || scalarTypeFromEnd(0) != scalarType<T>())
+			throw std::runtime_error("std::optional<int64_t> Processor::typedMathOper() operands don't match the specialized opcode");
+	}
+	T operB = *reinterpret_cast<const T*>(popScalar());
+	T operA = *reinterpret_cast<const T*>(popScalar());
+	*reinterpret_cast<T*>(pushScalar(scalarType<T>())) = Oper()(operA, operB);
+	return 0;
+}
+
+template<typename T, typename Oper>
+std::optional<int64_t> Processor::typedCompareOper()
+{
+	if(validationEnabled(ValidationLevel::light))
+	{
+		if(operandCount() < 2 || scalarTypeFromEnd(1) != scalarType<T>() || scalarTypeFromEnd(0) != scalarType<T>())
+			throw std::runtime_error("std::optional<int64_t> Processor::typedCompareOper() operands don't match the specialized opcode");
+	}
+	T operB = *reinterpret_cast<const T*>(popScalar());
+	T operA = *reinterpret_cast<const T*>(popScalar());
+	*reinterpret_cast<bool*>(pushScalar(boolType_)) = Oper()(operA, operB);
+	return 0;
 }
 
 bool has_input_nonblocking() 
@@ -876,7 +1545,7 @@ std::optional<int64_t> Processor::readCh_(Instruction&)
 
 	std::optional<char> chOpt = read<char>(noBlockingInput_);
 	char ch = chOpt.has_value() ? chOpt.value() : 0;
-	uint8_t* ptr = stack_.push(ElementInfo(&baseTypes_["char"]));
+	uint8_t* ptr = pushScalar(charType_);
 	*reinterpret_cast<char*>(ptr) = ch;
 	return 0;
 }
@@ -884,24 +1553,21 @@ std::optional<int64_t> Processor::readCh_(Instruction&)
 std::optional<int64_t> Processor::checkBuf_(Instruction&)
 {
 	bool res = has_input_nonblocking();
-	uint8_t* ptr = stack_.push(ElementInfo(&baseTypes_["bool"]));
+	uint8_t* ptr = pushScalar(boolType_);
 	*reinterpret_cast<bool*>(ptr) = res;
 	return 0;
 }
 
 std::optional<int64_t> Processor::setNoBlockingInput_(Instruction&)
 {
-	std::optional<Element> dataElemOpt = stack_.wholeElementFromEnd(0);
-	if(!dataElemOpt.has_value())
+	if(operandCount() == 0)
 		throw std::runtime_error("std::optional<int64_t> Processor::setNoBlockingInput_(Instruction&) invalid last stack element");
-	Element dataElem = dataElemOpt.value();
-	if(!dataElem.type().isBaseType())
+	const BaseType* dataType = scalarTypeFromEnd(0);
+	if(dataType == nullptr)
 		throw std::runtime_error("std::optional<int64_t> Processor::setNoBlockingInput_(Instruction&) incorrect last stack element");
-	if(dataElem.type().get<const BaseType*>() != &baseTypes_["bool"])
+	if(dataType != boolType_)
 		throw std::runtime_error("std::optional<int64_t> Processor::setNoBlockingInput_(Instruction&) incopatible last stack element");
-	uint8_t* ptr = stack_.at(dataElem);
-	noBlockingInput_ = *reinterpret_cast<bool*>(ptr);
-	stack_.pop();
+	noBlockingInput_ = *reinterpret_cast<const bool*>(popScalar());
 	return 0;
 }
 
@@ -910,24 +1576,21 @@ std::optional<int64_t> Processor::readNum_(Instruction&)
 
 	std::optional<int64_t> chOpt = read<int64_t>(noBlockingInput_);
 	int64_t num = chOpt.has_value() ? chOpt.value() : 0;
-	uint8_t* ptr = stack_.push(ElementInfo(&baseTypes_["int64"]));
+	uint8_t* ptr = pushScalar(int64Type_);
 	*reinterpret_cast<int64_t*>(ptr) = num;
 	return 0;
 }
 
 std::optional<int64_t> Processor::printCh_(Instruction&)
 {
-	std::optional<Element> dataElemOpt = stack_.wholeElementFromEnd(0);
-	if(!dataElemOpt.has_value())
+	if(operandCount() == 0)
 		throw std::runtime_error("std::optional<int64_t> Processor::printCh_(Instruction&) invalid last stack element");
-	Element dataElem = dataElemOpt.value();
-	if(!dataElem.type().isBaseType())
+	const BaseType* dataType = scalarTypeFromEnd(0);
+	if(dataType == nullptr)
 		throw std::runtime_error("std::optional<int64_t> Processor::printCh_(Instruction&) incorrect last stack element");
-	if(dataElem.type().get<const BaseType*>() != &baseTypes_["char"])
+	if(dataType != charType_)
 		throw std::runtime_error("std::optional<int64_t> Processor::printCh_(Instruction&) incopatible last stack element");
-	uint8_t* dataPtr = stack_.at(dataElem);
-	char ch = *reinterpret_cast<char*>(dataPtr);
-	stack_.pop();
+	char ch = *reinterpret_cast<const char*>(popScalar());
 	std::cout << ch;
 	fflush(stdout);
 	return 0;
@@ -935,17 +1598,14 @@ std::optional<int64_t> Processor::printCh_(Instruction&)
 
 std::optional<int64_t> Processor::printNum_(Instruction&)
 {
-	std::optional<Element> dataElemOpt = stack_.wholeElementFromEnd(0);
-	if(!dataElemOpt.has_value())
+	if(operandCount() == 0)
 		throw std::runtime_error("std::optional<int64_t> Processor::printNum_(Instruction&) invalid last stack element");
-	Element dataElem = dataElemOpt.value();
-	if(!dataElem.type().isBaseType())
+	const BaseType* dataType = scalarTypeFromEnd(0);
+	if(dataType == nullptr)
 		throw std::runtime_error("std::optional<int64_t> Processor::printNum_(Instruction&) incorrect last stack element");
-	if(dataElem.type().get<const BaseType*>() != &baseTypes_["int64"])
+	if(dataType != int64Type_)
 		throw std::runtime_error("std::optional<int64_t> Processor::printNum_(Instruction&) incopatible last stack element");
-	uint8_t* dataPtr = stack_.at(dataElem);
-	int64_t num = *reinterpret_cast<int64_t*>(dataPtr);
-	stack_.pop();
+	int64_t num = *reinterpret_cast<const int64_t*>(popScalar());
 	std::cout << num;
 	fflush(stdout);
 	return 0;
@@ -958,11 +1618,12 @@ std::optional<int64_t> Processor::peekCh_(Instruction&)
 		ch = 0;
 	else
 		std::cin >> ch;
-	uint8_t* ptr = stack_.push(ElementInfo(&baseTypes_["char"]));
+	uint8_t* ptr = pushScalar(charType_);
 	*reinterpret_cast<char*>(ptr) = ch;
 	return 0;
 }
 
+
 std::optional<int64_t> Processor::stackRealloc_(Instruction&) //заглушка
 {
 	return 0;
@@ -1003,6 +1664,12 @@ std::optional<int64_t> Processor::execute(Instruction& instruction)
 	case OpCode::getSublink_:
 		return getSublink_(instruction);
 		break;
+	case OpCode::getField_:
+		return getField_(instruction);
+		break;
+	case OpCode::getSublinks_:
+		return getSublinks_(instruction);
+		break;
 	case OpCode::if_:
 		return if_(instruction);
 		break;
@@ -1081,6 +1748,122 @@ std::optional<int64_t> Processor::execute(Instruction& instruction)
 	case OpCode::neq_:
 		return neq_(instruction);
 		break;
+	case OpCode::addI64_:
+		return typedMathOper<int64_t, std::plus<int64_t>>();
+	case OpCode::subI64_:
+		return typedMathOper<int64_t, std::minus<int64_t>>();
+	case OpCode::mulI64_:
+		return typedMathOper<int64_t, std::multiplies<int64_t>>();
+	case OpCode::divI64_:
+		return typedMathOper<int64_t, std::divides<int64_t>>();
+	case OpCode::modI64_:
+		return typedMathOper<int64_t, std::modulus<int64_t>>();
+	case OpCode::shlI64_:
+		return typedMathOper<int64_t, ShiftLeft>();
+	case OpCode::shrI64_:
+		return typedMathOper<int64_t, ShiftRight>();
+	case OpCode::lsI64_:
+		return typedCompareOper<int64_t, std::less<int64_t>>();
+	case OpCode::leqI64_:
+		return typedCompareOper<int64_t, std::less_equal<int64_t>>();
+	case OpCode::bgI64_:
+		return typedCompareOper<int64_t, std::greater<int64_t>>();
+	case OpCode::beqI64_:
+		return typedCompareOper<int64_t, std::greater_equal<int64_t>>();
+	case OpCode::equI64_:
+		return typedCompareOper<int64_t, std::equal_to<int64_t>>();
+	case OpCode::neqI64_:
+		return typedCompareOper<int64_t, std::not_equal_to<int64_t>>();
+	case OpCode::addChar_:
+		return typedMathOper<char, std::plus<char>>();
+	case OpCode::subChar_:
+		return typedMathOper<char, std::minus<char>>();
+	case OpCode::mulChar_:
+		return typedMathOper<char, std::multiplies<char>>();
+	case OpCode::divChar_:
+		return typedMathOper<char, std::divides<char>>();
+	case OpCode::modChar_:
+		return typedMathOper<char, std::modulus<char>>();
+	case OpCode::shlChar_:
+		return typedMathOper<char, ShiftLeft>();
+	case OpCode::shrChar_:
+		return typedMathOper<char, ShiftRight>();
+	case OpCode::lsChar_:
+		return typedCompareOper<char, std::less<char>>();
+	case OpCode::leqChar_:
+		return typedCompareOper<char, std::less_equal<char>>();
+	case OpCode::bgChar_:
+		return typedCompareOper<char, std::greater<char>>();
+	case OpCode::beqChar_:
+		return typedCompareOper<char, std::greater_equal<char>>();
+	case OpCode::equChar_:
+		return typedCompareOper<char, std::equal_to<char>>();
+	case OpCode::neqChar_:
+		return typedCompareOper<char, std::not_equal_to<char>>();
+	case OpCode::addF64_:
+		return typedMathOper<double, std::plus<double>>();
+	case OpCode::subF64_:
+		return typedMathOper<double, std::minus<double>>();
+	case OpCode::mulF64_:
+		return typedMathOper<double, std::multiplies<double>>();
+	case OpCode::divF64_:
+		return typedMathOper<double, std::divides<double>>();
+	case OpCode::lsF64_:
+		return typedCompareOper<double, std::less<double>>();
+	case OpCode::leqF64_:
+		return typedCompareOper<double, std::less_equal<double>>();
+	case OpCode::bgF64_:
+		return typedCompareOper<double, std::greater<double>>();
+	case OpCode::beqF64_:
+		return typedCompareOper<double, std::greater_equal<double>>();
+	case OpCode::equF64_:
+		return typedCompareOper<double, std::equal_to<double>>();
+	case OpCode::neqF64_:
+		return typedCompareOper<double, std::not_equal_to<double>>();
+	case OpCode::arrAdd_:
+		return arrayOper(ElementwiseOp::add);
+	case OpCode::arrSub_:
+		return arrayOper(ElementwiseOp::sub);
+	case OpCode::arrMul_:
+		return arrayOper(ElementwiseOp::mul);
+	case OpCode::arrMin_:
+		return arrayOper(ElementwiseOp::min);
+	case OpCode::arrMax_:
+		return arrayOper(ElementwiseOp::max);
+	case OpCode::arrLs_:
+		return arrayCompare(CompareOp::ls);
+	case OpCode::arrLeq_:
+		return arrayCompare(CompareOp::leq);
+	case OpCode::arrBg_:
+		return arrayCompare(CompareOp::bg);
+	case OpCode::arrBeq_:
+		return arrayCompare(CompareOp::beq);
+	case OpCode::arrEqu_:
+		return arrayCompare(CompareOp::equ);
+	case OpCode::arrNeq_:
+		return arrayCompare(CompareOp::neq);
+	case OpCode::reduceSum_:
+		return reduceOper(instruction, ReduceOp::sum);
+	case OpCode::reduceProd_:
+		return reduceOper(instruction, ReduceOp::product);
+	case OpCode::reduceMin_:
+		return reduceOper(instruction, ReduceOp::min);
+	case OpCode::reduceMax_:
+		return reduceOper(instruction, ReduceOp::max);
+	case OpCode::reduceDot_:
+		return dotOper(instruction);
+	case OpCode::countEqu_:
+		return countOper();
+	case OpCode::copyRange_:
+		return copyRange_(instruction);
+	case OpCode::fillRange_:
+		return fillRange_(instruction);
+	case OpCode::alloc_:
+		return alloc_(instruction);
+	case OpCode::free_:
+		return free_(instruction);
+	case OpCode::deref_:
+		return deref_(instruction);
 	default:
 		throw std::runtime_error("std::optional<int64_t> Processor::execute(Instruction&) unknown Opcode");
 		break;
@@ -1091,7 +1874,7 @@ std::optional<int64_t> Processor::execute(Instruction& instruction)
 std::optional<int64_t> Processor::run()
 {
 	//std::cout << "start execution" << std::endl;
-	functionStackStartPositions_.push_back(0);
+	functionEntry(globalFrame_);
 	for(Instruction& inst : program_)
 	{
 		//std::cout << "executing" << std::endl;
@@ -1102,9 +1885,19 @@ std::optional<int64_t> Processor::run()
 		execute(inst);
 	}
 	functionStackStartPositions_.pop_back();
+	frameBases_.pop_back();
+	frameGenerations_.pop_back();
+	borrows_.clear();
 	return 0;
 }
 
+void Processor::reserveStack(size_t bytes, size_t elements, size_t operands)
+{
+	stack_.reserve(bytes, elements);
+	if(operands != 0)
+		operands_.reserve(operands);
+}
+
 void Processor::notifyStackReallocation(uint8_t* /*new_data*/) // Currently does nothing
 {
 	//execute(Instruction(OpCode::stackRealloc_, {}));
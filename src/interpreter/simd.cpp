@@ -0,0 +1,708 @@
+#include "interpreter/simd.h"
+
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BPL_SIMD_X86
+#endif
+
+static SimdLevel detectSimdLevel()
+{
+#if defined BPL_SIMD_X86
+	__builtin_cpu_init(); // may run from a static initializer, before the runtime does it
+	if(__builtin_cpu_supports("avx2"))
+		return SimdLevel::avx2;
+	if(__builtin_cpu_supports("sse2"))
+		return SimdLevel::sse2;
+#endif
+	return SimdLevel::scalar;
+}
+
+SimdLevel detectedSimdLevel()
+{
+	static SimdLevel level = detectSimdLevel();
+	return level;
+}
+
+static SimdLevel simdLevel_ = detectedSimdLevel();
+
+SimdLevel simdLevel()
+{
+	return simdLevel_;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+	simdLevel_ = static_cast<SimdLevel>(std::min(static_cast<int>(level), static_cast<int>(detectedSimdLevel())));
+}
+
+
+
+template<typename T, typename Oper>
+static void scalarLoop(const T* a, const T* b, T* result, size_t from, size_t count, Oper oper)
+{
+	for(size_t i = from; i < count; ++i)
+		result[i] = oper(a[i], b[i]);
+}
+
+template<typename T>
+static void elementwiseScalar(ElementwiseOp op, const T* a, const T* b, T* result, size_t from, size_t count)
+{
+	switch(op)
+	{
+	case ElementwiseOp::add:
+		scalarLoop(a, b, result, from, count, std::plus<T>());
+		break;
+	case ElementwiseOp::sub:
+		scalarLoop(a, b, result, from, count, std::minus<T>());
+		break;
+	case ElementwiseOp::mul:
+		scalarLoop(a, b, result, from, count, std::multiplies<T>());
+		break;
+	case ElementwiseOp::min:
+		scalarLoop(a, b, result, from, count, [](T x, T y){ return x < y ? x : y; });
+		break;
+	case ElementwiseOp::max:
+		scalarLoop(a, b, result, from, count, [](T x, T y){ return x > y ? x : y; });
+		break;
+	}
+}
+
+template<typename T, typename Oper>
+static void scalarMaskLoop(const T* a, const T* b, bool* mask, size_t from, size_t count, Oper oper)
+{
+	for(size_t i = from; i < count; ++i)
+		mask[i] = oper(a[i], b[i]);
+}
+
+template<typename T>
+static void compareScalar(CompareOp op, const T* a, const T* b, bool* mask, size_t from, size_t count)
+{
+	switch(op)
+	{
+	case CompareOp::ls:
+		scalarMaskLoop(a, b, mask, from, count, std::less<T>());
+		break;
+	case CompareOp::leq:
+		scalarMaskLoop(a, b, mask, from, count, std::less_equal<T>());
+		break;
+	case CompareOp::bg:
+		scalarMaskLoop(a, b, mask, from, count, std::greater<T>());
+		break;
+	case CompareOp::beq:
+		scalarMaskLoop(a, b, mask, from, count, std::greater_equal<T>());
+		break;
+	case CompareOp::equ:
+		scalarMaskLoop(a, b, mask, from, count, std::equal_to<T>());
+		break;
+	case CompareOp::neq:
+		scalarMaskLoop(a, b, mask, from, count, std::not_equal_to<T>());
+		break;
+	}
+}
+
+#if defined BPL_SIMD_X86
+
+static void storeMask(bool* mask, int bits, size_t lanes) // bit i of a movemask result to mask[i]
+{
+	for(size_t lane = 0; lane < lanes; ++lane)
+		mask[lane] = (bits >> lane) & 1;
+}
+
+// every kernel handles whole vectors only and returns how many elements it did, the scalar loop finishes the tail
+
+__attribute__((target("sse2")))
+static size_t elementwiseSse2(ElementwiseOp op, const int64_t* a, const int64_t* b, int64_t* result, size_t count)
+{
+	if(op != ElementwiseOp::add && op != ElementwiseOp::sub) // SSE2 has no 64-bit multiply, min or max
+		return 0;
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		__m128i r = op == ElementwiseOp::add ? _mm_add_epi64(x, y) : _mm_sub_epi64(x, y);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), r);
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t elementwiseSse2(ElementwiseOp op, const double* a, const double* b, double* result, size_t count)
+{
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(a + i);
+		__m128d y = _mm_loadu_pd(b + i);
+		__m128d r;
+		switch(op)
+		{
+		case ElementwiseOp::add: r = _mm_add_pd(x, y); break;
+		case ElementwiseOp::sub: r = _mm_sub_pd(x, y); break;
+		case ElementwiseOp::mul: r = _mm_mul_pd(x, y); break;
+		case ElementwiseOp::min: r = _mm_min_pd(x, y); break; // x < y ? x : y
+		case ElementwiseOp::max: r = _mm_max_pd(x, y); break; // x > y ? x : y
+		default: return i;
+		}
+		_mm_storeu_pd(result + i, r);
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t compareSse2(CompareOp op, const double* a, const double* b, bool* mask, size_t count)
+{
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(a + i);
+		__m128d y = _mm_loadu_pd(b + i);
+		__m128d r;
+		switch(op)
+		{
+		case CompareOp::ls: r = _mm_cmplt_pd(x, y); break;
+		case CompareOp::leq: r = _mm_cmple_pd(x, y); break;
+		case CompareOp::bg: r = _mm_cmpgt_pd(x, y); break;
+		case CompareOp::beq: r = _mm_cmpge_pd(x, y); break;
+		case CompareOp::equ: r = _mm_cmpeq_pd(x, y); break;
+		case CompareOp::neq: r = _mm_cmpneq_pd(x, y); break;
+		default: return i;
+		}
+		storeMask(mask + i, _mm_movemask_pd(r), 2);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t elementwiseAvx2(ElementwiseOp op, const int64_t* a, const int64_t* b, int64_t* result, size_t count)
+{
+	if(op == ElementwiseOp::mul) // no 64-bit multiply before AVX-512
+		return 0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		__m256i r;
+		switch(op)
+		{
+		case ElementwiseOp::add: r = _mm256_add_epi64(x, y); break;
+		case ElementwiseOp::sub: r = _mm256_sub_epi64(x, y); break;
+		case ElementwiseOp::min: r = _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y)); break;
+		case ElementwiseOp::max: r = _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y)); break;
+		default: return i;
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), r);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t elementwiseAvx2(ElementwiseOp op, const double* a, const double* b, double* result, size_t count)
+{
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(a + i);
+		__m256d y = _mm256_loadu_pd(b + i);
+		__m256d r;
+		switch(op)
+		{
+		case ElementwiseOp::add: r = _mm256_add_pd(x, y); break;
+		case ElementwiseOp::sub: r = _mm256_sub_pd(x, y); break;
+		case ElementwiseOp::mul: r = _mm256_mul_pd(x, y); break;
+		case ElementwiseOp::min: r = _mm256_min_pd(x, y); break;
+		case ElementwiseOp::max: r = _mm256_max_pd(x, y); break;
+		default: return i;
+		}
+		_mm256_storeu_pd(result + i, r);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t compareAvx2(CompareOp op, const int64_t* a, const int64_t* b, bool* mask, size_t count)
+{
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		int bits;
+		switch(op) // only greater and equal exist, the rest are their swaps and complements
+		{
+		case CompareOp::ls: bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(y, x))); break;
+		case CompareOp::leq: bits = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, y))); break;
+		case CompareOp::bg: bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, y))); break;
+		case CompareOp::beq: bits = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(y, x))); break;
+		case CompareOp::equ: bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, y))); break;
+		case CompareOp::neq: bits = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, y))); break;
+		default: return i;
+		}
+		storeMask(mask + i, bits, 4);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t compareAvx2(CompareOp op, const double* a, const double* b, bool* mask, size_t count)
+{
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(a + i);
+		__m256d y = _mm256_loadu_pd(b + i);
+		__m256d r;
+		switch(op) // ordered predicates, except neq which like != is true for NaN
+		{
+		case CompareOp::ls: r = _mm256_cmp_pd(x, y, _CMP_LT_OQ); break;
+		case CompareOp::leq: r = _mm256_cmp_pd(x, y, _CMP_LE_OQ); break;
+		case CompareOp::bg: r = _mm256_cmp_pd(x, y, _CMP_GT_OQ); break;
+		case CompareOp::beq: r = _mm256_cmp_pd(x, y, _CMP_GE_OQ); break;
+		case CompareOp::equ: r = _mm256_cmp_pd(x, y, _CMP_EQ_OQ); break;
+		case CompareOp::neq: r = _mm256_cmp_pd(x, y, _CMP_NEQ_UQ); break;
+		default: return i;
+		}
+		storeMask(mask + i, _mm256_movemask_pd(r), 4);
+	}
+	return i;
+}
+
+#endif
+
+
+
+void elementwise(ElementwiseOp op, const int64_t* a, const int64_t* b, int64_t* result, size_t count)
+{
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = elementwiseAvx2(op, a, b, result, count);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = elementwiseSse2(op, a, b, result, count);
+#endif
+	elementwiseScalar(op, a, b, result, done, count);
+}
+
+void elementwise(ElementwiseOp op, const double* a, const double* b, double* result, size_t count)
+{
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = elementwiseAvx2(op, a, b, result, count);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = elementwiseSse2(op, a, b, result, count);
+#endif
+	elementwiseScalar(op, a, b, result, done, count);
+}
+
+void compareMask(CompareOp op, const int64_t* a, const int64_t* b, bool* mask, size_t count)
+{
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = compareAvx2(op, a, b, mask, count);
+#endif
+	compareScalar(op, a, b, mask, done, count);
+}
+
+void compareMask(CompareOp op, const double* a, const double* b, bool* mask, size_t count)
+{
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = compareAvx2(op, a, b, mask, count);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = compareSse2(op, a, b, mask, count);
+#endif
+	compareScalar(op, a, b, mask, done, count);
+}
+
+
+
+template<typename T>
+static T wrappingAdd(T a, T b) // integer sums wrap like the vector lanes do instead of overflowing
+{
+	if constexpr(std::is_integral_v<T>)
+		return static_cast<T>(static_cast<std::make_unsigned_t<T>>(a) + static_cast<std::make_unsigned_t<T>>(b));
+	else
+		return a + b;
+}
+
+template<typename T>
+static T wrappingMul(T a, T b)
+{
+	if constexpr(std::is_integral_v<T>)
+		return static_cast<T>(static_cast<std::make_unsigned_t<T>>(a) * static_cast<std::make_unsigned_t<T>>(b));
+	else
+		return a * b;
+}
+
+template<typename T, typename Oper>
+static T foldLoop(const T* data, size_t from, size_t count, T acc, Oper oper)
+{
+	for(size_t i = from; i < count; ++i)
+		acc = oper(acc, data[i]);
+	return acc;
+}
+
+template<typename T>
+static T reduceScalar(ReduceOp op, const T* data, size_t from, size_t count, T acc)
+{
+	switch(op)
+	{
+	case ReduceOp::sum:
+		return foldLoop(data, from, count, acc, wrappingAdd<T>);
+	case ReduceOp::product:
+		return foldLoop(data, from, count, acc, wrappingMul<T>);
+	case ReduceOp::min:
+		return foldLoop(data, from, count, acc, [](T x, T y){ return y < x ? y : x; });
+	case ReduceOp::max:
+		return foldLoop(data, from, count, acc, [](T x, T y){ return y > x ? y : x; });
+	}
+	return acc;
+}
+
+template<typename T>
+static T dotScalar(const T* a, const T* b, size_t from, size_t count, T acc)
+{
+	for(size_t i = from; i < count; ++i)
+		acc = wrappingAdd(acc, wrappingMul(a[i], b[i]));
+	return acc;
+}
+
+template<typename T>
+static size_t countEqualScalar(const T* data, T value, size_t from, size_t count)
+{
+	size_t found = 0;
+	for(size_t i = from; i < count; ++i)
+		found += data[i] == value;
+	return found;
+}
+
+#if defined BPL_SIMD_X86
+
+// reduction kernels fold whole vectors into acc and return how many elements they covered; 1 means nothing was done
+// and acc still holds data[0]
+
+__attribute__((target("avx2")))
+static size_t reduceAvx2(ReduceOp op, const int64_t* data, size_t count, int64_t& acc)
+{
+	if(op == ReduceOp::product || count < 8)
+		return 1;
+	__m256i vector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+	size_t i = 4;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		if(op == ReduceOp::sum)
+			vector = _mm256_add_epi64(vector, x);
+		else if(op == ReduceOp::min)
+			vector = _mm256_blendv_epi8(vector, x, _mm256_cmpgt_epi64(vector, x));
+		else
+			vector = _mm256_blendv_epi8(vector, x, _mm256_cmpgt_epi64(x, vector));
+	}
+	alignas(32) int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vector);
+	acc = reduceScalar(op, lanes, 1, 4, lanes[0]);
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t reduceSse2(ReduceOp op, const int64_t* data, size_t count, int64_t& acc)
+{
+	if(op != ReduceOp::sum || count < 4) // no 64-bit compare before SSE4.2
+		return 1;
+	__m128i vector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+	size_t i = 2;
+	for(; i + 2 <= count; i += 2)
+		vector = _mm_add_epi64(vector, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+	alignas(16) int64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), vector);
+	acc = wrappingAdd(lanes[0], lanes[1]);
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t reduceAvx2(ReduceOp op, const char* data, size_t count, char& acc)
+{
+	if(op == ReduceOp::product || count < 64)
+		return 1;
+	__m256i vector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+	size_t i = 32;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		if(op == ReduceOp::sum)
+			vector = _mm256_add_epi8(vector, x);
+		else if(op == ReduceOp::min)
+			vector = _mm256_min_epi8(vector, x);
+		else
+			vector = _mm256_max_epi8(vector, x);
+	}
+	alignas(32) char lanes[32];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vector);
+	acc = reduceScalar(op, lanes, 1, 32, lanes[0]);
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t reduceSse2(ReduceOp op, const char* data, size_t count, char& acc)
+{
+	if(op != ReduceOp::sum || count < 32) // signed byte min and max need SSE4.1
+		return 1;
+	__m128i vector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+	size_t i = 16;
+	for(; i + 16 <= count; i += 16)
+		vector = _mm_add_epi8(vector, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+	alignas(16) char lanes[16];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), vector);
+	acc = reduceScalar(ReduceOp::sum, lanes, 1, 16, lanes[0]);
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t reduceAvx2(ReduceOp op, const double* data, size_t count, double& acc)
+{
+	if(count < 8)
+		return 1;
+	__m256d vector = _mm256_loadu_pd(data);
+	size_t i = 4;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(data + i);
+		switch(op)
+		{
+		case ReduceOp::sum: vector = _mm256_add_pd(vector, x); break;
+		case ReduceOp::product: vector = _mm256_mul_pd(vector, x); break;
+		case ReduceOp::min: vector = _mm256_min_pd(x, vector); break; // x < vector ? x : vector, as the scalar fold
+		case ReduceOp::max: vector = _mm256_max_pd(x, vector); break;
+		}
+	}
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, vector);
+	acc = reduceScalar(op, lanes, 1, 4, lanes[0]);
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t reduceSse2(ReduceOp op, const double* data, size_t count, double& acc)
+{
+	if(count < 4)
+		return 1;
+	__m128d vector = _mm_loadu_pd(data);
+	size_t i = 2;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(data + i);
+		switch(op)
+		{
+		case ReduceOp::sum: vector = _mm_add_pd(vector, x); break;
+		case ReduceOp::product: vector = _mm_mul_pd(vector, x); break;
+		case ReduceOp::min: vector = _mm_min_pd(x, vector); break;
+		case ReduceOp::max: vector = _mm_max_pd(x, vector); break;
+		}
+	}
+	alignas(16) double lanes[2];
+	_mm_store_pd(lanes, vector);
+	acc = reduceScalar(op, lanes, 1, 2, lanes[0]);
+	return i;
+}
+
+// dot and count kernels start from zero, so they return the number of elements covered, possibly 0
+
+__attribute__((target("avx2")))
+static size_t dotAvx2(const double* a, const double* b, size_t count, double& acc)
+{
+	__m256d vector = _mm256_setzero_pd();
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+		vector = _mm256_add_pd(vector, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, vector);
+	acc = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t dotSse2(const double* a, const double* b, size_t count, double& acc)
+{
+	__m128d vector = _mm_setzero_pd();
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+		vector = _mm_add_pd(vector, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+	alignas(16) double lanes[2];
+	_mm_store_pd(lanes, vector);
+	acc = lanes[0] + lanes[1];
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t countEqualAvx2(const int64_t* data, int64_t value, size_t count, size_t& found)
+{
+	__m256i needle = _mm256_set1_epi64x(value);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), needle);
+		found += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(equal)));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t countEqualAvx2(const char* data, char value, size_t count, size_t& found)
+{
+	__m256i needle = _mm256_set1_epi8(value);
+	size_t i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), needle);
+		found += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(equal)));
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t countEqualSse2(const char* data, char value, size_t count, size_t& found)
+{
+	__m128i needle = _mm_set1_epi8(value);
+	size_t i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), needle);
+		found += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(equal)));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t countEqualAvx2(const double* data, double value, size_t count, size_t& found)
+{
+	__m256d needle = _mm256_set1_pd(value);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+		found += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i), needle, _CMP_EQ_OQ)));
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t countEqualSse2(const double* data, double value, size_t count, size_t& found)
+{
+	__m128d needle = _mm_set1_pd(value);
+	size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+		found += __builtin_popcount(_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(data + i), needle)));
+	return i;
+}
+
+#endif
+
+
+
+int64_t reduce(ReduceOp op, const int64_t* data, size_t count)
+{
+	int64_t acc = data[0];
+	size_t done = 1;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = reduceAvx2(op, data, count, acc);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = reduceSse2(op, data, count, acc);
+#endif
+	return reduceScalar(op, data, done, count, acc);
+}
+
+char reduce(ReduceOp op, const char* data, size_t count)
+{
+	char acc = data[0];
+	size_t done = 1;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = reduceAvx2(op, data, count, acc);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = reduceSse2(op, data, count, acc);
+#endif
+	return reduceScalar(op, data, done, count, acc);
+}
+
+double reduce(ReduceOp op, const double* data, size_t count, bool reassociate)
+{
+	double acc = data[0];
+	size_t done = 1;
+#if defined BPL_SIMD_X86
+	if(reassociate && simdLevel_ == SimdLevel::avx2)
+		done = reduceAvx2(op, data, count, acc);
+	else if(reassociate && simdLevel_ == SimdLevel::sse2)
+		done = reduceSse2(op, data, count, acc);
+#else
+	(void)reassociate;
+#endif
+	return reduceScalar(op, data, done, count, acc);
+}
+
+int64_t dot(const int64_t* a, const int64_t* b, size_t count) // no 64-bit vector multiply before AVX-512
+{
+	return dotScalar(a, b, 0, count, int64_t(0));
+}
+
+char dot(const char* a, const char* b, size_t count)
+{
+	return dotScalar(a, b, 0, count, char(0));
+}
+
+double dot(const double* a, const double* b, size_t count, bool reassociate)
+{
+	double acc = 0;
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(reassociate && simdLevel_ == SimdLevel::avx2)
+		done = dotAvx2(a, b, count, acc);
+	else if(reassociate && simdLevel_ == SimdLevel::sse2)
+		done = dotSse2(a, b, count, acc);
+#else
+	(void)reassociate;
+#endif
+	return dotScalar(a, b, done, count, acc);
+}
+
+size_t countEqual(const int64_t* data, int64_t value, size_t count)
+{
+	size_t found = 0;
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = countEqualAvx2(data, value, count, found);
+#endif
+	return found + countEqualScalar(data, value, done, count);
+}
+
+size_t countEqual(const char* data, char value, size_t count)
+{
+	size_t found = 0;
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = countEqualAvx2(data, value, count, found);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = countEqualSse2(data, value, count, found);
+#endif
+	return found + countEqualScalar(data, value, done, count);
+}
+
+size_t countEqual(const double* data, double value, size_t count)
+{
+	size_t found = 0;
+	size_t done = 0;
+#if defined BPL_SIMD_X86
+	if(simdLevel_ == SimdLevel::avx2)
+		done = countEqualAvx2(data, value, count, found);
+	else if(simdLevel_ == SimdLevel::sse2)
+		done = countEqualSse2(data, value, count, found);
+#endif
+	return found + countEqualScalar(data, value, done, count);
+}
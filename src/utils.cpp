@@ -1,17 +1,14 @@
 #include "utils.h"
 
-ValidationLevel validationLevel_ = ValidationLevel::basic; // Default
+#include <algorithm>
+
+ValidationLevel validationLevel_ = std::min(ValidationLevel::basic, compiledValidationLevel); // Default
 
 bool allowResizeStack_ = false; // because the current implementation is very insecure, if it works at all
 
 void setValidationLevel(ValidationLevel level)
 {
-	validationLevel_ = level;
-}
-
-ValidationLevel getValidationLevel()
-{
-	return validationLevel_;
+	validationLevel_ = std::min(level, compiledValidationLevel);
 }
 
 bool getAllowResizeStack()
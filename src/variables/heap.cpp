@@ -0,0 +1,188 @@
+#include "variables/heap.h"
+
+#include "utils.h"
+
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+Heap::Heap() : liveBlocks_(0)
+{
+	for(size_t i = 0; i < classCount; ++i)
+	{
+		freeLists_[i] = nullptr;
+		carve_[i] = nullptr;
+		carveEnd_[i] = nullptr;
+	}
+}
+
+Heap::~Heap()
+{
+	clear();
+}
+
+size_t Heap::sizeClass(size_t size)
+{
+	size_t index = 0;
+	for(size_t blockSize = minBlockSize; blockSize < size; blockSize *= 2)
+		++index;
+	return index;
+}
+
+uint8_t* Heap::allocate(size_t size)
+{
+	if(size == 0)
+		size = 1;
+	uint8_t* data;
+	if(size > maxBlockSize)
+	{
+		data = static_cast<uint8_t*>(operator new(size, std::align_val_t(minBlockSize)));
+		large_.insert(data);
+	}
+	else
+	{
+		size_t index = sizeClass(size);
+		size_t blockSize = minBlockSize << index;
+		if(freeLists_[index] != nullptr)
+		{
+			data = reinterpret_cast<uint8_t*>(freeLists_[index]);
+			freeLists_[index] = freeLists_[index]->next;
+		}
+		else
+		{
+			if(carve_[index] == carveEnd_[index])
+			{
+				uint8_t* slab = static_cast<uint8_t*>(operator new(slabSize, std::align_val_t(minBlockSize)));
+				slabs_.push_back(slab);
+				carve_[index] = slab;
+				carveEnd_[index] = slab + slabSize;
+			}
+			data = carve_[index];
+			carve_[index] += blockSize;
+		}
+		size = blockSize;
+	}
+	memset(data, 0, size);
+	++liveBlocks_;
+	return data;
+}
+
+void Heap::deallocate(uint8_t* data, size_t size)
+{
+	if(data == nullptr)
+		return;
+	if(size > maxBlockSize)
+	{
+		if(large_.erase(data) == 0)
+			throw std::invalid_argument("void Heap::deallocate(uint8_t*, size_t) block wasn't allocated by this Heap");
+		operator delete(data, std::align_val_t(minBlockSize));
+	}
+	else
+	{
+		size_t index = sizeClass(size == 0 ? 1 : size);
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(data);
+		uintptr_t poison = freePoison ^ reinterpret_cast<uintptr_t>(data);
+		// a live block may hold the poison by chance, the free list walk only runs then
+		if(validationEnabled(ValidationLevel::light) && block->poison == poison && isFree(index, block))
+			throw std::invalid_argument("void Heap::deallocate(uint8_t*, size_t) block is already free");
+		block->next = freeLists_[index];
+		block->poison = poison;
+		freeLists_[index] = block;
+	}
+	--liveBlocks_;
+}
+
+bool Heap::isFree(size_t index, const FreeBlock* block) const
+{
+	for(const FreeBlock* free = freeLists_[index]; free != nullptr; free = free->next)
+	{
+		if(free == block)
+			return true;
+	}
+	return false;
+}
+
+void Heap::clear()
+{
+	for(void* slab : slabs_)
+		operator delete(slab, std::align_val_t(minBlockSize));
+	for(void* block : large_)
+		operator delete(block, std::align_val_t(minBlockSize));
+	slabs_.clear();
+	large_.clear();
+	for(size_t i = 0; i < classCount; ++i)
+	{
+		freeLists_[i] = nullptr;
+		carve_[i] = nullptr;
+		carveEnd_[i] = nullptr;
+	}
+	liveBlocks_ = 0;
+}
+
+Region::~Region()
+{
+	release(Mark{0, 0});
+	for(const Chunk& chunk : spare_)
+		operator delete(chunk.data, std::align_val_t(Heap::minBlockSize));
+}
+
+uint8_t* Region::allocate(size_t size)
+{
+	size = (size + Heap::minBlockSize - 1) / Heap::minBlockSize * Heap::minBlockSize;
+	if(size == 0)
+		size = Heap::minBlockSize;
+	if(chunks_.empty() || chunks_.back().size - used_ < size)
+	{
+		if(size <= chunkSize && !spare_.empty())
+		{
+			chunks_.push_back(spare_.back());
+			spare_.pop_back();
+		}
+		else
+		{
+			size_t chunk = std::max(size, chunkSize);
+			chunks_.push_back(Chunk{static_cast<uint8_t*>(operator new(chunk, std::align_val_t(Heap::minBlockSize))), chunk});
+		}
+		used_ = 0;
+	}
+	uint8_t* data = chunks_.back().data + used_;
+	used_ += size;
+	memset(data, 0, size);
+	return data;
+}
+
+void Region::release(Mark mark)
+{
+	while(chunks_.size() > mark.chunks)
+	{
+		if(chunks_.back().size == chunkSize)
+			spare_.push_back(chunks_.back());
+		else
+			operator delete(chunks_.back().data, std::align_val_t(Heap::minBlockSize));
+		chunks_.pop_back();
+	}
+	used_ = mark.used;
+}
+
+bool Region::owns(const uint8_t* data) const
+{
+	for(const Chunk& chunk : chunks_)
+	{
+		if(data >= chunk.data && data < chunk.data + chunk.size)
+			return true;
+	}
+	return false;
+}
+
+bool Region::released(const uint8_t* data) const
+{
+	if(!chunks_.empty() && data >= chunks_.back().data + used_ && data < chunks_.back().data + chunks_.back().size)
+		return true;
+	for(const Chunk& chunk : spare_)
+	{
+		if(data >= chunk.data && data < chunk.data + chunk.size)
+			return true;
+	}
+	return false;
+}
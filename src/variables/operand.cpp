@@ -0,0 +1,59 @@
+#include "variables/operand.h"
+
+OperandStack::OperandStack(size_t capacity) : slots_(capacity), size_(0), spill_(capacity * sizeof(Operand)), spillTop_(0)
+{}
+
+uint8_t* OperandStack::push(const TypeVariant& type)
+{
+	if(size_ == slots_.size())
+		slots_.resize(slots_.size() * 2 + 1);
+	Operand& operand = slots_[size_];
+	operand.type_ = type;
+	operand.size_ = type.size();
+	operand.source_ = SIZE_MAX;
+	++size_;
+	if(!operand.spilled())
+		return operand.data_;
+	if(spillTop_ + operand.size_ > spill_.size())
+		spill_.resize((spillTop_ + operand.size_) * 2);
+	*reinterpret_cast<size_t*>(operand.data_) = spillTop_;
+	spillTop_ += operand.size_;
+	return spill_.data() + spillTop_ - operand.size_;
+}
+
+uint8_t* OperandStack::borrow(const TypeVariant& type, size_t source)
+{
+	uint8_t* data = push(type);
+	slots_[size_ - 1].source_ = source;
+	return data;
+}
+
+void OperandStack::reserve(size_t capacity)
+{
+	if(size_ != 0)
+		throw std::runtime_error("OperandStack::reserve(size_t) called on non-empty OperandStack");
+	slots_ = std::vector<Operand>(capacity);
+}
+
+void OperandStack::pop()
+{
+	if(size_ == 0)
+		throw std::runtime_error("OperandStack::pop() OperandStack is empty");
+	--size_;
+	if(slots_[size_].spilled())
+		spillTop_ = *reinterpret_cast<size_t*>(slots_[size_].data_);
+}
+
+void OperandStack::pop(size_t count)
+{
+	for(size_t i = 0; i < count; ++i)
+		pop();
+}
+
+void OperandStack::popTo(size_t size)
+{
+	if(size > size_)
+		throw std::runtime_error("OperandStack::popTo(size_t) size is above the top");
+	while(size_ > size)
+		pop();
+}
@@ -1,32 +1,114 @@
 #include "variables/stack.h"
 #include "interpreter/processor.h"
 
-Stack::Stack(Processor* processor ,size_t capacity, bool cleanStackBeforeUse): top_(0), levels_({0}),
-processor_(processor), capacity_(capacity), elementCounter_(0), cleanStackBeforeUse_(cleanStackBeforeUse)
+#include <sys/mman.h>
+
+static const size_t hugePageSize = 2 << 20;
+
+Stack::Stack(Processor* processor ,size_t capacity, bool cleanStackBeforeUse, bool hugePages): top_(0), levels_({0}),
+processor_(processor), capacity_(capacity), elementCounter_(0), watermark_(0), cleanStackBeforeUse_(cleanStackBeforeUse), bounded_(false),
+hugePages_(hugePages), hugetlb_(false), transparentHuge_(false), mapped_(0)
 {
-	data_ = (uint8_t*)malloc(sizeof(uint8_t) * capacity);
-	if(!data_)
-		throw std::bad_alloc();
+	// fresh anonymous pages are zero-filled, so nothing above watermark_ ever needs clearing
+	map(capacity_);
 }
 
 Stack::~Stack()
 {
-	free(data_);
+	munmap(data_, mapped_);
+}
+
+size_t Stack::mappingSize(size_t capacity) const
+{
+	if(capacity == 0)
+		return 1;
+	if(!hugePages_ || capacity < hugePageSize / 2) // a mostly empty huge page would cost more than the TLB entries it saves
+		return capacity;
+	return (capacity + hugePageSize - 1) / hugePageSize * hugePageSize;
+}
+
+void Stack::map(size_t capacity)
+{
+	mapped_ = mappingSize(capacity);
+	hugetlb_ = false;
+	transparentHuge_ = false;
+	if(hugePages_ && mapped_ % hugePageSize == 0) // without the opt-in a capacity may still be a multiple of 2 MiB
+	{
+		void* data = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(data != MAP_FAILED)
+		{
+			hugetlb_ = true;
+			data_ = static_cast<uint8_t*>(data);
+			return;
+		}
+		// no reserved huge pages: take a 2 MiB aligned range and ask for transparent huge pages instead
+		void* raw = mmap(nullptr, mapped_ + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(raw == MAP_FAILED)
+			throw std::bad_alloc();
+		uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+		uintptr_t aligned = (start + hugePageSize - 1) / hugePageSize * hugePageSize;
+		if(aligned != start)
+			munmap(raw, aligned - start);
+		if(aligned + mapped_ != start + mapped_ + hugePageSize)
+			munmap(reinterpret_cast<void*>(aligned + mapped_), start + hugePageSize - aligned);
+		data_ = reinterpret_cast<uint8_t*>(aligned);
+		madvise(data_, mapped_, MADV_HUGEPAGE);
+		transparentHuge_ = true;
+		return;
+	}
+	void* data = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(data == MAP_FAILED)
+		throw std::bad_alloc();
+	data_ = static_cast<uint8_t*>(data);
+}
+
+void Stack::remap(size_t capacity)
+{
+	size_t mapped = mappingSize(capacity);
+	if(hugetlb_ || (hugePages_ && mapped % hugePageSize == 0 && mapped_ % hugePageSize != 0))
+	{
+		// hugetlb mappings can't be mremap'ed, and a small mapping can't become aligned in place
+		uint8_t* oldData = data_;
+		size_t oldMapped = mapped_;
+		map(capacity);
+		memcpy(data_, oldData, std::min(top_, capacity));
+		munmap(oldData, oldMapped);
+		return;
+	}
+	void* data = mremap(data_, mapped_, mapped, MREMAP_MAYMOVE);
+	if(data == MAP_FAILED)
+		throw std::bad_alloc();
+	data_ = static_cast<uint8_t*>(data);
+	mapped_ = mapped;
+	transparentHuge_ = hugePages_ && mapped_ % hugePageSize == 0;
+	if(transparentHuge_)
+		madvise(data_, mapped_, MADV_HUGEPAGE);
 }
 
 uint8_t* Stack::push(const ElementInfo& element, bool initAfterPush)
 {
 	size_t elementSize = element.size();
-	if (top_ + elementSize > capacity_)
-		resize((top_ + element.size()) * 2);
+	size_t pos = alignUp(top_, element.type().alignment()); // data_ is page aligned, so pos alignment is address alignment
+	if (!bounded_ && pos + elementSize > capacity_)
+		resize((pos + elementSize) * 2);
 
-	elements_.push_back(Element(element, top_, elementCounter_));
-	if(cleanStackBeforeUse_ && !initAfterPush)
-		memset(data_ + top_, 0, elementSize);
-	top_ += elementSize;
+	elements_.push_back(Element(element, pos, elementCounter_));
+	if(cleanStackBeforeUse_ && !initAfterPush && pos < watermark_)
+		memset(data_ + pos, 0, std::min(elementSize, watermark_ - pos));
+	top_ = pos + elementSize;
+	if(top_ > watermark_)
+		watermark_ = top_;
 	++levels_.back();
 	elementCounter_ += element.elementCount();
-	return data_ + top_ - elementSize;
+	return data_ + pos;
+}
+
+void Stack::cleanAboveTop()
+{
+	if(!cleanStackBeforeUse_ || top_ >= watermark_)
+		return;
+	memset(data_ + top_, 0, watermark_ - top_);
+	watermark_ = top_;
 }
 
 uint8_t* Stack::push(const Element& element)
@@ -40,11 +122,11 @@ void Stack::pop()
 {
 	if(elements_.empty())
 		throw std::runtime_error("Stack::pop() Stack is empty");
-	if(elements_.back().size() > top_)
-		throw std::runtime_error("Stack::pop() Incorrect Stack: elements_.back().size() > top_");
-	top_ -= elements_.back().size();
+	if(elements_.back().pos() + elements_.back().size() != top_)
+		throw std::runtime_error("Stack::pop() Incorrect Stack: elements_.back() doesn't end at top_");
 	elementCounter_ -= elements_.back().elementCount();
 	elements_.pop_back();
+	top_ = elements_.empty() ? 0 : elements_.back().pos() + elements_.back().size(); // also drops the alignment padding
 	if(levels_.back() == 0)
 		levels_.pop_back();
 	--levels_.back();
@@ -181,18 +263,29 @@ void Stack::resize(size_t new_capacity)
 {
 	if(!getAllowResizeStack())
 		throw std::runtime_error("Stack::resize(): stack overflow - resizing is forbidden yet, for use enable it via utils::setAllowResizeStack(true)");
-	data_ = (uint8_t*)realloc(data_, new_capacity * sizeof(uint8_t));
-	if(!data_)
-		throw std::bad_alloc();
+	remap(new_capacity);
 	capacity_ = new_capacity;
 	processor_->notifyStackReallocation(data_);
 }
 
+void Stack::reserve(size_t capacity, size_t elementCount)
+{
+	if(!elements_.empty())
+		throw std::runtime_error("Stack::reserve(size_t, size_t) called on non-empty Stack");
+	remap(capacity);
+	capacity_ = capacity;
+	watermark_ = 0;
+	elements_.reserve(elementCount);
+}
+
 void Stack::clear()
 {
 	elements_.clear();
 	top_ = 0;
 	levels_.clear();
+	region_.release(Region::Mark{0, 0});
+	regionLevels_.clear();
+	cleanAboveTop();
 }
 
 void Stack::newLevel()
@@ -206,13 +299,26 @@ void Stack::popLevel()
 	if(levels_.empty())
 		throw std::runtime_error("Stack::popLevel() No level to pop");
 	size_t count = levels_.back();
-	pop(count);
-	levels_.pop_back();
 	if(count > elements_.size())
 		throw std::runtime_error("Stack::popLevel() Incorrect Stack: count > elements_.size()");
+	pop(count);
+	if(!regionLevels_.empty() && regionLevels_.back().first == levels_.size())
+	{
+		region_.release(regionLevels_.back().second);
+		regionLevels_.pop_back();
+	}
+	levels_.pop_back();
+	cleanAboveTop();
 	return;
 }
 
+uint8_t* Stack::regionAllocate(size_t size)
+{
+	if(regionLevels_.empty() || regionLevels_.back().first != levels_.size()) // marks are taken lazily, so levels that never allocate cost nothing
+		regionLevels_.push_back({levels_.size(), region_.mark()});
+	return region_.allocate(size);
+}
+
 void Stack::popToLevel(size_t level)
 {
 	if(level >= levels_.size())
@@ -1,5 +1,7 @@
 #include "variables/type.h"
 
+#include <algorithm>
+
 #include "interpreter/processor.h"
 
 
@@ -7,7 +9,7 @@
 
 BaseType::BaseType(size_t size) : size_(size) 
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::invalid_argument("Invalid BaseType parameters");
@@ -16,7 +18,7 @@ BaseType::BaseType(size_t size) : size_(size)
 
 size_t BaseType::size() const 
 {
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("BaseType::size() called on invalid BaseType");
@@ -31,14 +33,33 @@ bool BaseType::isValid() const
 
 
 
-StructType::StructType(const std::vector<TypeVariant>& types, const std::vector<std::string>& fieldNames) : 
-types_(types), fieldNames_(fieldNames), totalSize_(0)
+StructType::StructType(const std::vector<TypeVariant>& types, const std::vector<std::string>& fieldNames, StructLayout layout, size_t alignment) : 
+types_(types), fieldNames_(fieldNames), layout_(layout), alignment_(alignment == 0 ? 1 : alignment), totalSize_(0), elementCount_(1)
 {
+	if((alignment_ & (alignment_ - 1)) != 0)
+		throw std::invalid_argument("StructType::StructType(const std::vector<TypeVariant>&, const std::vector<std::string>&, StructLayout, size_t) alignment is not a power of two");
+	offsets_.reserve(types_.size() + 1);
+	subIndexes_.reserve(types_.size() + 1);
+	offsets_.push_back(0);
+	subIndexes_.push_back(0);
+	typeIds_.reserve(types_.size() + 1);
+	typeIds_.push_back(0);
 	for (size_t i = 0; i < types_.size(); ++i)
 	{
+		typeIds_.push_back(TypeTable::instance().intern(types_[i]));
+		if(layout_ == StructLayout::natural)
+		{
+			size_t fieldAlignment = types_[i].alignment();
+			totalSize_ = alignUp(totalSize_, fieldAlignment);
+			alignment_ = std::max(alignment_, fieldAlignment);
+		}
+		offsets_.push_back(totalSize_);
+		subIndexes_.push_back(elementCount_);
 		totalSize_ += types_[i].size();
+		elementCount_ += types_[i].elementCount();
 	}
-	if(getValidationLevel() >= ValidationLevel::basic)
+	totalSize_ = alignUp(totalSize_, alignment_);
+	if(validationEnabled(ValidationLevel::basic))
 	{
 		if(!isValid())
 			throw std::invalid_argument("StructType::StructType(std::string, const std::vector<TypeVariant>&) Invalid parameters");
@@ -47,7 +68,7 @@ types_(types), fieldNames_(fieldNames), totalSize_(0)
 
 size_t StructType::size() const 
 { 
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::size() called on invalid StructType");
@@ -57,7 +78,7 @@ size_t StructType::size() const
 
 const std::vector<TypeVariant>& StructType::types() const 
 {
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::baseTypes() called on invalid StructType");
@@ -67,7 +88,7 @@ const std::vector<TypeVariant>& StructType::types() const
 
 TypeVariant StructType::type(size_t index) const
 {
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::baseTypes() called on invalid StructType");
@@ -81,24 +102,24 @@ TypeVariant StructType::type(size_t index) const
 
 bool StructType::operator==(const StructType& other) const
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!other.isValid())
 			throw std::invalid_argument("StructType::operator==(const StructType&) invalid other StructType");
 	}
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::operator==(const StructType&) called on invalid StructType");
 	}
-	return types_ == other.types_;
+	return types_ == other.types_ && layout_ == other.layout_ && alignment_ == other.alignment_;
 }
 
 bool StructType::isValid() const
 {
 	if(types_.empty())
 		return false;
-	if(getValidationLevel() < ValidationLevel::basic)
+	if(!validationEnabled(ValidationLevel::basic))
 		return true;
 	for(size_t i = 0; i < types_.size(); ++i)
 	{
@@ -108,210 +129,80 @@ bool StructType::isValid() const
 	return true;
 }
 
-std::vector<size_t> StructType::elementSubIndexes() const
+size_t StructType::elementSubIndex(size_t index) const
 {
-	std::vector<size_t> subIndexes;
-	subIndexes.reserve(types_.size());
-	subIndexes.push_back(0);
-	size_t top = 1;
-	for(size_t i = 0; i < types_.size(); ++i)
-	{
-		subIndexes.push_back(top);
-		top += types_[i].elementCount();
-	}
-	return subIndexes;
+	if(index > types_.size())
+		throw std::out_of_range("StructType::elementSubIndex(size_t) index out of range");
+	return subIndexes_[index];
 }
 
-size_t StructType::elementSubIndex(size_t index) const
+size_t StructType::fieldBySubIndex(size_t subIndex) const
 {
-	if(index == 0)
+	if(subIndex >= elementCount_)
+		throw std::out_of_range("StructType::fieldBySubIndex(size_t) sub-index out of range");
+	if(subIndex == 0)
 		return 0;
-	if(index > types_.size())
-		throw std::out_of_range("StructType::elementSubIndex(size_t) index out of range");
-	size_t top = 1;
-	for(size_t i = 0; i < index - 1; ++i)
-	{
-		top += types_[i].elementCount();
-	}
-	return top;
+	return std::upper_bound(subIndexes_.begin() + 1, subIndexes_.end(), subIndex) - subIndexes_.begin() - 1;
 }
 
-std::vector<size_t> StructType::offsetsBySize() const
+const std::vector<size_t>& StructType::offsetsBySize() const
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::offsetsBySize(size_t) called on invalid StructType");
 	}
-	std::vector<size_t> offsets;
-	offsets.reserve(types_.size() + 1);
-	size_t currentOffset = 0;
-	offsets.push_back(0);
-	for(size_t i = 0; i < types_.size(); ++i)
-	{
-		offsets.push_back(currentOffset);
-		currentOffset += types_[i].size();
-	}
-	return offsets;
+	return offsets_;
 }
 
 size_t StructType::offsetBySize(size_t index) const
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::runtime_error("StructType::offsetsBySize(size_t) called on invalid StructType");
 	}
 	if(index > types_.size())
 		throw std::out_of_range("StructType::offsetsBySize(size_t) index out of range");
-	if(index == 0)
-		return 0;
-	size_t offset = 0;
-	for(size_t i = 0; i < index-1; ++i)
-	{
-		offset += types_[i].size();
-	}
-	return offset;
+	return offsets_[index];
 }
 
 
 
-PointerType::PointerType(TypeVariant pointerType) : pointerType_(new TypeVariant)
+PointerType::PointerType(TypeVariant pointerType) : pointerType_(TypeTable::instance().intern(pointerType))
 {
-	*pointerType_ = pointerType;
-	if(getValidationLevel() >= ValidationLevel::basic)
+	if(validationEnabled(ValidationLevel::basic))
 	{
 		if(!isValid())
 			throw std::invalid_argument("PointerType::PointerType(TypeVariant) Invalid PointerType parameters");
 	}
 }
 
-TypeVariant PointerType::pointerType() const 
+const TypeVariant& PointerType::pointerType() const 
 {
-	if(pointerType_ == nullptr)
+	if(pointerType_ == 0)
 		throw std::runtime_error("PointerType::pointerType() called on null pointerType_");
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("PointerType::pointerType() called on invalid PointerType");
 	}
-	return *pointerType_; 
-}
-
-PointerType::PointerType(const PointerType& other) : pointerType_(new TypeVariant()) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid PointerType::PointerType(const PointerType&) parameters");
-	}
-	*pointerType_ = other.pointerType();
-}
-
-PointerType::PointerType(PointerType&& other) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid PointerType::PointerType(PointerType&&) parameters");
-	}
-	pointerType_ = std::move(other.pointerType_);
-}
-
-PointerType& PointerType::operator=(const PointerType& other)
-{
-	if (this == &other)
-		return *this;
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid PointerType::operator=(const PointerType&) parameters");
-	}
-	if(pointerType_ == nullptr)
-		pointerType_ = std::make_unique<TypeVariant>();
-	*pointerType_ = other.pointerType();
-	
-	return *this;
-}
-
-PointerType& PointerType::operator=(PointerType&& other)
-{
-	if (this == &other)
-		return *this;
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid PointerType::operator=(PointerType&&) parameters");
-	}
-	pointerType_ = std::move(other.pointerType_);
-	return *this;
+	return TypeTable::instance().type(pointerType_); 
 }
 
 bool PointerType::isValid() const
 {
-	if(pointerType_ == nullptr)
+	if(pointerType_ == 0)
 		return false;
-	if(getValidationLevel() < ValidationLevel::basic)
+	if(!validationEnabled(ValidationLevel::basic))
 		return true;
-	return pointerType_->isValid();
-}
-
-bool PointerType::operator==(const PointerType& other) const
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("PointerType::operator==(const PointerType&) invalid other PointerType");
-	}
-	if(getValidationLevel() >= ValidationLevel::full)
-	{
-		if(!isValid())
-			throw std::runtime_error("PointerType::operator==(const PointerType&) called on invalid PointerType");
-	}
-	return pointerType() == other.pointerType();
+	return TypeTable::instance().type(pointerType_).isValid();
 }
 
 
 
-LinkType::LinkType(TypeVariant elementType)
-{
-	elementType_ = std::make_unique<TypeVariant>(elementType);
-}
-
-LinkType::LinkType()
-{
-	elementType_ = nullptr;
-}
-
-LinkType::LinkType(const LinkType& other)
-{
-	if(other.elementType_ == nullptr)
-	{	
-		elementType_ = nullptr;
-		return;
-	}
-	elementType_ = std::make_unique<TypeVariant>(*other.elementType_);
-}
-LinkType::LinkType(LinkType&& other)
-{
-	elementType_ = std::move(other.elementType_);
-}
-
-LinkType LinkType::operator=(const LinkType& other)
-{
-	if(other.elementType_ == nullptr)
-	{	
-		elementType_ = nullptr;
-		return *this;
-	}
-	elementType_ = std::make_unique<TypeVariant>(*other.elementType_);
-	return *this;
-}
-LinkType LinkType::operator=(LinkType&& other)
-{
-	elementType_ = std::move(other.elementType_);
-	return *this;
-}
+LinkType::LinkType(TypeVariant elementType) : elementType_(TypeTable::instance().intern(elementType))
+{}
 
 size_t LinkType::size() const
 {
@@ -320,45 +211,44 @@ size_t LinkType::size() const
 
 std::optional<TypeVariant> LinkType::pointsTo() const
 {
-	if (!elementType_)
+	if (elementType_ == 0)
 		return std::nullopt;
-	return *elementType_;
+	return TypeTable::instance().type(elementType_);
 }
 
 bool LinkType::isValid() const
 {
-	if(elementType_ == nullptr)
+	if(elementType_ == 0)
 		return true;
-	return elementType_->isValid();
+	return TypeTable::instance().type(elementType_).isValid();
 }
 
 
 
-ArrayType::ArrayType(TypeVariant elementType, size_t count) : elementType_(new TypeVariant), count_(count) 
+ArrayType::ArrayType(TypeVariant elementType, size_t count) : elementType_(TypeTable::instance().intern(elementType)), count_(count) 
 {
-	*elementType_ = elementType;
-	if(getValidationLevel() >= ValidationLevel::basic)
+	if(validationEnabled(ValidationLevel::basic))
 	{
 		if(!isValid())
 			throw std::invalid_argument("ArrayType::ArrayType(TypeVariant, size_t) Invalid ArrayType parameters");
 	}
 }
 
-TypeVariant ArrayType::elementType() const 
+const TypeVariant& ArrayType::elementType() const 
 {
-	if(elementType_ == nullptr)
+	if(elementType_ == 0)
 		throw std::runtime_error("ArrayType::elementType() called on null elementType_");
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("ArrayType::elementType() called on invalid ArrayType");
 	}
-	return *elementType_;
+	return TypeTable::instance().type(elementType_);
 }
 
 size_t ArrayType::count() const 
 {
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("ArrayType::count() called on invalid ArrayType");
@@ -368,259 +258,96 @@ size_t ArrayType::count() const
 
 size_t ArrayType::size() const 
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::runtime_error("ArrayType::size() called on invalid ArrayType");
 	}
-	 return elementType().size() * count_;
-}
-
-ArrayType::ArrayType(ArrayType&& other) : count_(other.count_) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid ArrayType::ArrayType(ArrayType&&) parameters");
-	}
-	if(getValidationLevel() >= ValidationLevel::full)
-	{
-		if(!isValid())
-			throw std::runtime_error("ArrayType::ArrayType(ArrayType&&) called on invalid ArrayType");
-	}
-	elementType_ = std::move(other.elementType_);
-	other.count_ = 0;
-}
-
-ArrayType::ArrayType(const ArrayType& other) : elementType_(new TypeVariant), count_(other.count_) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid ArrayType::ArrayType(const ArrayType&) parameters");
-	}
-	*elementType_ = other.elementType();
-}
-
-ArrayType& ArrayType::operator=(ArrayType&& other)
-{
-	if (this == &other)
-		return *this;
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid ArrayType::operator=(ArrayType&&) parameters");
-	}
-	elementType_ = std::move(other.elementType_);
-	count_ = other.count_;
-	other.count_ = 0;
-	other.elementType_ = nullptr;
-	return *this;
-}
-
-ArrayType& ArrayType::operator=(const ArrayType& other)
-{
-	if (this == &other)
-		return *this;
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid ArrayType::operator=(const ArrayType&) parameters");
-	}
-	if(elementType_ == nullptr)
-		elementType_ = std::make_unique<TypeVariant>();
-	*elementType_ = other.elementType();
-	count_ = other.count_;
-	return *this;
+	 return TypeTable::instance().size(elementType_) * count_;
 }
 
 bool ArrayType::isValid() const
 {
-	if(elementType_ == nullptr)
+	if(elementType_ == 0)
 		return false;
 	if(count_ == 0)
 		return false;
-	if(getValidationLevel() < ValidationLevel::basic)
+	if(!validationEnabled(ValidationLevel::basic))
 		return true;
-	return elementType_->isValid();
-}
-
-bool ArrayType::operator==(const ArrayType& other) const
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!isValid() || !other.isValid())
-			throw std::runtime_error("ArrayType::operator== called on invalid ArrayType");
-	}
-	return elementType() == other.elementType() && count_ == other.count_;
-}
-
-std::vector<size_t> ArrayType::elementSubIndexes() const
-{
-	std::vector<size_t> subIndexes;
-	size_t elementSize = elementType_->elementCount();
-	subIndexes.reserve(count_ + 1);
-	subIndexes.push_back(0);
-	size_t top = 1;
-	for(size_t i = 0; i < count_; ++i)
-	{
-		subIndexes.push_back(i);
-		top += elementSize;
-	}
-	return subIndexes;
+	return TypeTable::instance().type(elementType_).isValid();
 }
 
 size_t ArrayType::elementCount() const
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::runtime_error("ArrayType::elementCount() called on invalid ArrayType");
 	}
-	return elementType_->elementCount() * count_ + 1;
+	return TypeTable::instance().elementCount(elementType_) * count_ + 1;
 }
 
 
 
 FunctionType::FunctionType(const std::vector<TypeVariant>& argumentsTypes, TypeVariant returnType) :
-	argumentsTypes_(argumentsTypes), returnType_(std::make_unique<TypeVariant>(returnType))
+	signature_(TypeTable::instance().internSignature(argumentsTypes, returnType))
 {
-	if(getValidationLevel() >= ValidationLevel::basic)
+	if(validationEnabled(ValidationLevel::basic))
 	{
 		if(!isValid())
 			throw std::invalid_argument("FunctionType::FunctionType(TypeVariant, const std::vector<TypeVariant>&) Invalid FunctionType parameters");
 	}
 }
 
-FunctionType::FunctionType(FunctionType&& other) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid FunctionType::FunctionType(FunctionType&&) parameters");
-	}
-	returnType_ = std::move(other.returnType_);
-	argumentsTypes_ = std::move(other.argumentsTypes_);
-}
-
-FunctionType::FunctionType(const FunctionType& other) 
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid FunctionType::FunctionType(const FunctionType&) parameters");
-	}
-	returnType_ = std::make_unique<TypeVariant>(*other.returnType_);
-	argumentsTypes_ = other.argumentsTypes_;
-}
-
-FunctionType& FunctionType::operator=(const FunctionType& other)
-{
-	if (this == &other)
-		return *this;
-
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid FunctionType::operator=(const FunctionType&) parameters");
-	}
-
-	returnType_ =  std::make_unique<TypeVariant>(*other.returnType_);
-	argumentsTypes_ = other.argumentsTypes_;
-	return *this;
-}
-
-FunctionType& FunctionType::operator=(FunctionType&& other)
-{
-	if (this == &other)
-		return *this;
-
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!other.isValid())
-			throw std::invalid_argument("Invalid FunctionType::operator=(FunctionType&&) parameters");
-	}
-
-	returnType_ = std::move(other.returnType_);
-	argumentsTypes_ = std::move(other.argumentsTypes_);
-	return *this;
-}
-
 bool FunctionType::isValid() const
 {
-	if(returnType_ == nullptr)
+	if(signature_ == 0)
 		return false;
-	//std::cout << "returnType_ check" << std::endl;
-	if(!returnType_->isValid())
+	const TypeTable& table = TypeTable::instance();
+	if(!table.signatureReturn(signature_).isValid())
 		return false;
-	//std::cout << "returnType_ checked" << std::endl;
-	if(getValidationLevel() < ValidationLevel::basic)
+	if(!validationEnabled(ValidationLevel::basic))
 		return true;
-	
-	for(size_t i = 0; i < argumentsTypes_.size(); ++i)
+	for(const TypeVariant& argumentType : table.signatureArguments(signature_))
 	{
-		if(!argumentsTypes_[i].isValid())
+		if(!argumentType.isValid())
 			return false;
 	}
 	return true;
 }
 
-TypeVariant& FunctionType::returnType()  
-{
-	if(getValidationLevel() >= ValidationLevel::light)
-	{
-		if(!isValid())
-			throw std::runtime_error("FunctionType::returnType() called on invalid FunctionType");
-	}
-	return *returnType_; 
-}
-
 const TypeVariant& FunctionType::returnType() const
 {
-	if(getValidationLevel() >= ValidationLevel::light)
+	if(validationEnabled(ValidationLevel::light))
 	{
 		if(!isValid())
 			throw std::runtime_error("FunctionType::returnType() called on invalid FunctionType");
 	}
-	return *returnType_; 
+	return TypeTable::instance().signatureReturn(signature_); 
 }
 
 const std::vector<TypeVariant>& FunctionType::argumentsTypes() const 
 {
-	if(getValidationLevel() >= ValidationLevel::full)
-	{
-		if(!isValid())
-			throw std::runtime_error("std::vector<TypeVariant>& FunctionType::argumentsTypes() called on invalid FunctionType");
-	}
-	return argumentsTypes_; 
-}
-
-std::vector<TypeVariant>& FunctionType::argumentsTypes() 
-{
-	if(getValidationLevel() >= ValidationLevel::full)
+	if(validationEnabled(ValidationLevel::full))
 	{
 		if(!isValid())
 			throw std::runtime_error("std::vector<TypeVariant>& FunctionType::argumentsTypes() called on invalid FunctionType");
 	}
-	return argumentsTypes_; 
+	return TypeTable::instance().signatureArguments(signature_); 
 }
 
 void FunctionType::setReturnType(const TypeVariant& rt)
 {
-	if(returnType_ != nullptr)
-		*returnType_ = rt;
-	else
-		returnType_ = std::make_unique<TypeVariant>(rt);
+	TypeTable& table = TypeTable::instance();
+	std::vector<TypeVariant> argumentsTypes;
+	if(signature_ != 0)
+		argumentsTypes = table.signatureArguments(signature_);
+	signature_ = table.internSignature(argumentsTypes, rt);
 }
 
 size_t FunctionType::size() const 
 {
-	return sizeof(std::vector<Instruction>*);
-}
-
-bool FunctionType::operator==(const FunctionType& other) const
-{
-	return returnType() == other.returnType() && argumentsTypes_ == other.argumentsTypes_;
+	return sizeof(Function*);
 }
 
 
@@ -639,9 +366,16 @@ bool TypeVariant::operator==(const TypeVariant& other) const
 		return std::get<PointerType>(*this) == other.get<PointerType>();
 	else if (isArrayType())
 		return std::get<ArrayType>(*this) == other.get<ArrayType>();
+	else if (isLinkType())
+		return std::get<LinkType>(*this) == other.get<LinkType>();
 	return false;
 }
 
+TypeId TypeVariant::id() const
+{
+	return TypeTable::instance().intern(*this);
+}
+
 bool TypeVariant::operator!=(const TypeVariant& other) const
 {
 	return !(*this == other);
@@ -720,6 +454,72 @@ size_t TypeVariant::size() const
 	throw std::runtime_error("TypeVariant::size() called on unknown TypeVariant type");
 	return 0;
 }
+size_t TypeVariant::alignment() const
+{
+	if(isStructType())
+		return get<const StructType*>()->alignment();
+	if(isArrayType())
+		return get<ArrayType>().elementType().alignment();
+	size_t typeSize = size(); // scalars are aligned to their size, at most to a machine word
+	size_t alignment = 1;
+	while(alignment < sizeof(void*) && typeSize % (alignment * 2) == 0)
+		alignment *= 2;
+	return alignment;
+}
+
+static void appendRange(std::vector<std::pair<size_t, size_t>>& ranges, size_t offset, size_t size) // merges runs that touch
+{
+	if(!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+		ranges.back().second += size;
+	else if(size != 0)
+		ranges.push_back({offset, size});
+}
+
+void TypeVariant::valueRanges(std::vector<std::pair<size_t, size_t>>& ranges, size_t offset) const
+{
+	std::vector<std::pair<size_t, size_t>> noRuns;
+	valueRanges(ranges, nullptr, noRuns, offset);
+}
+
+void TypeVariant::valueRanges(std::vector<std::pair<size_t, size_t>>& ranges, const BaseType* baseType, std::vector<std::pair<size_t, size_t>>& baseRuns, size_t offset) const
+{
+	if(isStructType())
+	{
+		const StructType* structType = get<const StructType*>();
+		for(size_t i = 1; i < structType->offsetsBySize().size(); ++i)
+			structType->type(i).valueRanges(ranges, baseType, baseRuns, offset + structType->offsetBySize(i));
+	}
+	else if(isArrayType())
+	{
+		const ArrayType& arrayType = get<ArrayType>();
+		std::vector<std::pair<size_t, size_t>> elementRanges;
+		std::vector<std::pair<size_t, size_t>> elementRuns;
+		arrayType.elementType().valueRanges(elementRanges, baseType, elementRuns);
+		size_t wholeSize = arrayType.elementSize() * arrayType.count();
+		if(elementRanges.size() == 1 && elementRuns.empty() && elementRanges[0].second == arrayType.elementSize()) // no padding, one run for the whole array
+		{
+			appendRange(ranges, offset, wholeSize);
+			return;
+		}
+		if(elementRuns.size() == 1 && elementRanges.empty() && elementRuns[0].second == arrayType.elementSize())
+		{
+			appendRange(baseRuns, offset, wholeSize);
+			return;
+		}
+		for(size_t i = 0; i < arrayType.count(); ++i)
+		{
+			for(const std::pair<size_t, size_t>& range : elementRanges)
+				appendRange(ranges, offset + i * arrayType.elementSize() + range.first, range.second);
+			for(const std::pair<size_t, size_t>& run : elementRuns)
+				appendRange(baseRuns, offset + i * arrayType.elementSize() + run.first, run.second);
+		}
+	}
+	else if(baseType != nullptr && isBaseType() && get<const BaseType*>() == baseType)
+		appendRange(baseRuns, offset, size());
+	else
+		appendRange(ranges, offset, size());
+}
+
 size_t TypeVariant::elementCount() const
 {
 	if (isBaseType())
@@ -736,4 +536,159 @@ size_t TypeVariant::elementCount() const
 		return get<LinkType>().elementCount();
 	throw std::runtime_error("TypeVariant::elementCount() called on unknown TypeVariant type");
 	return 0;
-}
\ No newline at end of file
+}
+
+
+TypeTable::TypeTable()
+{
+	entries_.push_back(Entry{TypeVariant(), 0, 0}); // id 0 stands for "no type"
+	signatures_.push_back(Signature());
+}
+
+TypeTable& TypeTable::instance()
+{
+	static TypeTable table;
+	return table;
+}
+
+template<typename T>
+static void appendKey(std::string& key, T value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+TypeTable::Key TypeTable::key(const TypeVariant& type) const
+{
+	Key key{type.index(), {0, 0, 0}};
+	if(type.isBaseType())
+		key.parts[0] = reinterpret_cast<uintptr_t>(type.get<const BaseType*>());
+	else if(type.isStructType())
+		key.parts[0] = reinterpret_cast<uintptr_t>(type.get<const StructType*>());
+	else if(type.isFunctionType())
+		key.parts[0] = type.get<FunctionType>().signature();
+	else if(type.isPointerType())
+		key.parts[0] = type.get<PointerType>().pointerTypeId();
+	else if(type.isArrayType())
+	{
+		key.parts[0] = type.get<ArrayType>().elementTypeId();
+		key.parts[1] = type.get<ArrayType>().count();
+	}
+	else if(type.isLinkType())
+		key.parts[0] = type.get<LinkType>().pointsToId();
+	return key;
+}
+
+size_t TypeTable::KeyHash::operator()(const Key& key) const
+{
+	size_t hash = std::hash<uint64_t>()(key.kind);
+	for(uint64_t part : key.parts)
+		hash = hash * 1000003 ^ std::hash<uint64_t>()(part);
+	return hash;
+}
+
+bool TypeTable::ownsBaseType(const BaseType* baseType) const
+{
+	for(const BaseType& owned : baseTypes_)
+	{
+		if(&owned == baseType)
+			return true;
+	}
+	return false;
+}
+
+const BaseType* TypeTable::baseType(const std::string& name, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::unordered_map<std::string, const BaseType*>::const_iterator it = baseTypeNames_.find(name);
+	if(it != baseTypeNames_.end())
+	{
+		if(it->second->size() != size)
+			throw std::invalid_argument("const BaseType* TypeTable::baseType(const std::string&, size_t) base type already exists with another size");
+		return it->second;
+	}
+	baseTypes_.emplace_back(size);
+	baseTypeNames_.insert({name, &baseTypes_.back()});
+	return &baseTypes_.back();
+}
+
+const StructType* TypeTable::canonicalStructType(const StructType& structType)
+{
+	// fields are already interned, so their ids with the names and layout identify the struct
+	std::string structKey;
+	appendKey(structKey, static_cast<uint64_t>(structType.layout()));
+	appendKey(structKey, structType.alignment());
+	const std::vector<std::string>& fieldNames = structType.fieldNames();
+	for(size_t i = 1; i <= structType.types().size(); ++i)
+	{
+		appendKey(structKey, structType.typeId(i));
+		const std::string& fieldName = i <= fieldNames.size() ? fieldNames[i - 1] : std::string();
+		appendKey(structKey, fieldName.size());
+		structKey.append(fieldName);
+	}
+	std::unordered_map<std::string, const StructType*>::const_iterator it = structTypeIds_.find(structKey);
+	if(it != structTypeIds_.end())
+		return it->second;
+	structTypes_.push_back(structType);
+	structTypeIds_.insert({std::move(structKey), &structTypes_.back()});
+	return &structTypes_.back();
+}
+
+const StructType* TypeTable::structType(const StructType& structType)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return canonicalStructType(structType);
+}
+
+size_t TypeTable::structCount()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return structTypes_.size();
+}
+
+TypeId TypeTable::intern(const TypeVariant& type)
+{
+	if((type.isBaseType() && type.get<const BaseType*>() == nullptr) || (type.isStructType() && type.get<const StructType*>() == nullptr))
+		return 0;
+	std::lock_guard<std::mutex> lock(mutex_);
+	Key typeKey = key(type);
+	std::unordered_map<Key, TypeId, KeyHash>::const_iterator it = ids_.find(typeKey);
+	if(it != ids_.end())
+		return it->second;
+	// only table-owned base and struct types get an id, so an id never outlives the type it names
+	TypeVariant canonical = type;
+	if(type.isStructType())
+	{
+		canonical = TypeVariant(canonicalStructType(*type.get<const StructType*>()));
+		typeKey = key(canonical);
+		it = ids_.find(typeKey);
+		if(it != ids_.end())
+			return it->second;
+	}
+	else if(type.isBaseType() && validationEnabled(ValidationLevel::basic) && !ownsBaseType(type.get<const BaseType*>()))
+		throw std::invalid_argument("TypeId TypeTable::intern(const TypeVariant&) base type wasn't created by TypeTable::baseType");
+	TypeId id = static_cast<TypeId>(entries_.push_back(Entry{canonical, canonical.size(), canonical.elementCount()}));
+	ids_.insert({typeKey, id});
+	return id;
+}
+
+uint32_t TypeTable::internSignature(const std::vector<TypeVariant>& argumentsTypes, const TypeVariant& returnType)
+{
+	std::string signatureKey;
+	TypeId returnId = intern(returnType);
+	appendKey(signatureKey, returnId);
+	std::vector<TypeVariant> canonicalArguments;
+	canonicalArguments.reserve(argumentsTypes.size());
+	for(const TypeVariant& argumentType : argumentsTypes)
+	{
+		TypeId argumentId = intern(argumentType);
+		appendKey(signatureKey, argumentId);
+		canonicalArguments.push_back(argumentId == 0 ? argumentType : type(argumentId));
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::unordered_map<std::string, uint32_t>::const_iterator it = signatureIds_.find(signatureKey);
+	if(it != signatureIds_.end())
+		return it->second;
+	uint32_t signature = static_cast<uint32_t>(signatures_.push_back(Signature{std::move(canonicalArguments), returnId == 0 ? returnType : type(returnId)}));
+	signatureIds_.insert({std::move(signatureKey), signature});
+	return signature;
+}
@@ -0,0 +1,433 @@
+#include "../bpl_test.h"
+
+// own usage of a body with the given frame: frame bytes plus worst case padding, one Element, the deepest operand count
+static StackBounds frameBounds(const FrameLayout& frame, size_t operands)
+{
+	return StackBounds(frame.size() + frame.type().alignment() - 1, 1, operands);
+}
+
+static bool sameBounds(const std::optional<StackBounds>& bounds, const StackBounds& expected)
+{
+	return bounds.has_value() && bounds->bytes() == expected.bytes() && bounds->elements() == expected.elements() &&
+		bounds->operands() == expected.operands();
+}
+
+static const char* straightLine = R"(init:a
+type:int64
+init:b
+type:char
+get
+variable:a
+valfromarg
+value:int64:5
+set
+get
+variable:a
+valfromstlink
+get
+variable:a
+valfromstlink
+add
+printNum
+)";
+
+// main calls f, f calls g, g has a 32 byte local; callees are found by type, so f and g take different arguments
+static const char* nestedCalls = R"(init:g
+type:int64(int64,int64)
+init:f
+type:int64(int64)
+get
+variable:g
+valfromarg
+value:function:int64:int64 x:int64 w
+	init:buf
+	type:int64[4]
+	get
+	variable:x
+	valfromstlink
+	ret
+end
+set
+get
+variable:f
+valfromarg
+value:function:int64:int64 y
+	get
+	variable:y
+	valfromstlink
+	get
+	variable:y
+	valfromstlink
+	get
+	variable:g
+	valfromstlink
+	call
+	ret
+end
+set
+valfromarg
+value:int64:3
+get
+variable:f
+valfromstlink
+call
+printNum
+)";
+
+// f defines h as a value inside its own body and calls it through a local
+static const char* functionValue = R"(init:f
+type:int64(int64)
+get
+variable:f
+valfromarg
+value:function:int64:int64 y
+	init:h
+	type:int64(char)
+	get
+	variable:h
+	valfromarg
+	value:function:int64:char z
+		init:big
+		type:int64[16]
+		valfromarg
+		value:int64:97
+		ret
+	end
+	set
+	valfromarg
+	value:char:a
+	get
+	variable:h
+	valfromstlink
+	call
+	ret
+end
+set
+valfromarg
+value:int64:4
+get
+variable:f
+valfromstlink
+call
+printNum
+)";
+
+static const char* recursion = R"(init:fact
+type:int64(int64)
+get
+variable:fact
+valfromarg
+value:function:int64:int64 n
+	if
+	instructions
+		get
+		variable:n
+		valfromstlink
+		valfromarg
+		value:int64:2
+		ls
+	endInstructions
+	instructions
+		valfromarg
+		value:int64:1
+		ret
+	endInstructions
+	get
+	variable:n
+	valfromstlink
+	get
+	variable:n
+	valfromstlink
+	valfromarg
+	value:int64:1
+	sub
+	get
+	variable:fact
+	valfromstlink
+	call
+	mul
+	ret
+end
+set
+valfromarg
+value:int64:5
+get
+variable:fact
+valfromstlink
+call
+printNum
+)";
+
+static const Function& functionIn(const std::vector<Instruction>& program, size_t set) // value of the set-th valfromarg holding a Function
+{
+	for(const Instruction& inst : program)
+	{
+		if(inst.opCode() != OpCode::valfromarg_ || !std::holds_alternative<Function>(std::get<Value>(inst.arguments()[0])))
+			continue;
+		if(set-- == 0)
+			return std::get<Function>(std::get<Value>(inst.arguments()[0]));
+	}
+	throw std::runtime_error("no such function in program");
+}
+
+static void testStraightLine()
+{
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(straightLine));
+	Analyzer analyzer(&proc);
+	check(sameBounds(analyzer.analyze(proc.program()), frameBounds(proc.globalFrame(), 2)), "straight line bounds");
+}
+
+static void testNestedCalls()
+{
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(nestedCalls));
+	Analyzer analyzer(&proc);
+	std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+	const Function& g = functionIn(proc.program(), 0);
+	const Function& f = functionIn(proc.program(), 1);
+	check(sameBounds(analyzer.functionBounds(g), frameBounds(g.frame(), 1)), "callee own bounds");
+	check(sameBounds(analyzer.functionBounds(f), frameBounds(f.frame(), 3)), "caller own bounds");
+	StackBounds expected = frameBounds(proc.globalFrame(), 2);
+	expected += frameBounds(f.frame(), 3);
+	expected += frameBounds(g.frame(), 1);
+	expected += StackBounds(0, 0, 2); // return slots reserved by main and by f
+	check(sameBounds(bounds, expected), "nested call chain bounds");
+}
+
+static void testFunctionValue()
+{
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(functionValue));
+	Analyzer analyzer(&proc);
+	std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+	const Function& f = functionIn(proc.program(), 0);
+	const Function& h = functionIn(f.body(), 0);
+	check(sameBounds(analyzer.functionBounds(h), frameBounds(h.frame(), 1)), "function value own bounds");
+	StackBounds expected = frameBounds(proc.globalFrame(), 2);
+	expected += frameBounds(f.frame(), 2);
+	expected += frameBounds(h.frame(), 1);
+	expected += StackBounds(0, 0, 2);
+	check(sameBounds(bounds, expected), "bounds through a function defined as a value in its caller");
+}
+
+// while whose body inits a 64 byte array every iteration, built without the parser so init_ stays an instruction
+static std::vector<Instruction> loopWithInit(Processor& proc, int64_t iterations)
+{
+	TypeVariant int64Type(proc.int64Type());
+	return std::vector<Instruction>
+	{
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(int64Type)}),
+		Instruction(OpCode::while_, std::vector<Argument>{Argument(std::vector<Instruction>
+			{
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(iterations))}),
+				Instruction(OpCode::ls_, std::vector<Argument>{})
+			}),
+			Argument(std::vector<Instruction>
+			{
+				Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(ArrayType(int64Type, 8)))}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(int64_t(1)))}),
+				Instruction(OpCode::add_, std::vector<Argument>{}),
+				Instruction(OpCode::set_, std::vector<Argument>{})
+			})
+		})
+	};
+}
+
+static void testLoopWithInit()
+{
+	Processor proc;
+	proc.setProgram(loopWithInit(proc, 100));
+	Analyzer analyzer(&proc);
+	// the loop's init is counted once, as the stack level of every iteration is popped before the next
+	check(sameBounds(analyzer.analyze(proc.program()), StackBounds(8 + 7 + 64 + 7, 2, 3)), "loop with init bounds");
+}
+
+static void testUnbounded()
+{
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(recursion));
+	Analyzer analyzer(&proc);
+	check(!analyzer.analyze(proc.program()).has_value(), "recursion is unbounded");
+
+	Processor unknown;
+	FunctionType type(std::vector<TypeVariant>{}, TypeVariant(unknown.int64Type()));
+	unknown.setProgram(std::vector<Instruction>
+	{
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(type))}),
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}), // no frame slot, so the callee type is unknown
+		Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+		Instruction(OpCode::call_, std::vector<Argument>{})
+	});
+	Analyzer unknownAnalyzer(&unknown);
+	check(!unknownAnalyzer.analyze(unknown.program()).has_value(), "unknown callee is unbounded");
+}
+
+// runs the program on a stack reserved to exactly its bounds with the capacity check off
+static void checkBoundedRun(Processor& proc, const std::string& expected, const std::string& what)
+{
+	Analyzer analyzer(&proc);
+	std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+	check(bounds.has_value(), what + " is bounded");
+	if(!bounds.has_value())
+		return;
+	proc.reserveStack(bounds->bytes(), bounds->elements(), bounds->operands());
+	proc.setStackBounded(true);
+	check(runCaptured(proc) == expected, what + " output under bounded stack");
+	// without clearing, the watermark is the highest top_ the run reached
+	check(proc.stack().watermark() <= proc.stack().capacity(), what + " stays within the reserved capacity");
+	check(proc.stack().capacity() == bounds->bytes(), what + " runs on the exact reservation");
+}
+
+static void testBoundedRuns()
+{
+	Processor calls;
+	Parser parser(&calls);
+	calls.setProgram(parser.parse(nestedCalls));
+	checkBoundedRun(calls, "3", "nested calls");
+
+	Processor values;
+	Parser valuesParser(&values);
+	values.setProgram(valuesParser.parse(functionValue));
+	checkBoundedRun(values, "97", "function value");
+
+	Processor loop;
+	loop.setProgram(loopWithInit(loop, 100));
+	checkBoundedRun(loop, "", "loop with init");
+}
+
+// builds a program that stores every result in its own global, so typed results can be read back after the run
+class SpecializationProgram
+{
+	std::string declarations_;
+	std::string statements_;
+	size_t results_ = 0;
+public:
+	size_t operations = 0;
+
+	// a and b are already pushing instructions; op is applied to them and the result is stored
+	void add(const std::string& resultType, const std::string& a, const std::string& b, const std::string& op)
+	{
+		std::string name = "r" + std::to_string(results_++);
+		declarations_ += "init:" + name + "\ntype:" + resultType + "\n";
+		statements_ += "get\nvariable:" + name + "\n" + a + b + op + "\nset\n";
+		++operations;
+	}
+	static std::string value(const std::string& type, const std::string& literal) { return "valfromarg\nvalue:" + type + ":" + literal + "\n"; }
+	std::string source() const { return declarations_ + statements_; }
+};
+
+static bool hasOpCode(const std::vector<Instruction>& program, OpCode opCode)
+{
+	for(const Instruction& inst : program)
+	{
+		if(inst.opCode() == opCode)
+			return true;
+	}
+	return false;
+}
+
+static bool sameGlobals(const Processor& a, const Processor& b)
+{
+	const FrameLayout& frame = a.globalFrame();
+	const uint8_t* aData = a.stack().at(0).value();
+	const uint8_t* bData = b.stack().at(0).value();
+	for(size_t slot = 0; slot < frame.slotCount(); ++slot)
+	{
+		if(memcmp(aData + frame.slotOffset(slot), bData + frame.slotOffset(slot), frame.slotType(slot).size()) != 0)
+			return false;
+	}
+	return true;
+}
+
+template<typename T>
+static T global(const Processor& proc, size_t slot)
+{
+	T value;
+	memcpy(&value, proc.stack().at(0).value() + proc.globalFrame().slotOffset(slot), sizeof(T));
+	return value;
+}
+
+static void testSpecialization()
+{
+	SpecializationProgram program;
+	const std::vector<std::string> math{"add", "sub", "mul", "div", "mod", "shl", "shr"};
+	const std::vector<std::string> compare{"ls", "leq", "bg", "beq", "equ", "neq"};
+	std::string int64A = SpecializationProgram::value("int64", "-17"), int64B = SpecializationProgram::value("int64", "5");
+	std::string charA = SpecializationProgram::value("char", "d"), charB = SpecializationProgram::value("char", "#");
+	std::string doubleA = SpecializationProgram::value("double", "7.5"), doubleB = SpecializationProgram::value("double", "-2.5");
+	// shift counts stay small: the char count is '#' - '!' == 2, itself a specialized sub
+	std::string charShift = SpecializationProgram::value("char", "#") + SpecializationProgram::value("char", "!") + "sub\n";
+	for(const std::string& op : math)
+	{
+		bool shift = op == "shl" || op == "shr";
+		program.add("int64", shift ? SpecializationProgram::value("int64", "1000") : int64A, shift ? SpecializationProgram::value("int64", "3") : int64B, op);
+		program.add("char", charA, shift ? charShift : charB, op);
+		if(shift)
+			++program.operations;
+		if(op != "mod" && !shift)
+			program.add("double", doubleA, doubleB, op);
+	}
+	for(const std::string& op : compare)
+	{
+		program.add("bool", int64A, int64B, op);
+		program.add("bool", int64B, int64B, op);
+		program.add("bool", charA, charB, op);
+		program.add("bool", doubleA, doubleB, op);
+		program.add("bool", doubleB, doubleB, op);
+	}
+
+	Processor generic;
+	Parser genericParser(&generic);
+	generic.setProgram(genericParser.parse(program.source()));
+	runCaptured(generic);
+
+	Processor specialized;
+	Parser specializedParser(&specialized);
+	specialized.setProgram(specializedParser.parse(program.source()));
+	Analyzer analyzer(&specialized);
+	analyzer.analyze(specialized.program());
+	check(analyzer.specialize(specialized.program()) == program.operations, "every typed math and compare site is specialized");
+	check(hasOpCode(specialized.program(), OpCode::addI64_) && hasOpCode(specialized.program(), OpCode::lsChar_) &&
+		hasOpCode(specialized.program(), OpCode::divF64_) && !hasOpCode(specialized.program(), OpCode::add_), "sites are rewritten to typed opcodes");
+	runCaptured(specialized);
+	check(sameGlobals(generic, specialized), "specialized opcodes give the results of the generic ones");
+	check(global<int64_t>(specialized, 0) == -12 && global<char>(specialized, 1) == static_cast<char>('d' + '#') && global<double>(specialized, 2) == 5.0,
+		"specialized add results");
+	check(global<int64_t>(specialized, 9) == -3 && global<int64_t>(specialized, 12) == -2 && global<double>(specialized, 11) == -3.0,
+		"specialized div and mod results");
+
+	// a site whose two operands differ, or whose type has no typed opcode, stays generic
+	Processor mixed;
+	Parser mixedParser(&mixed);
+	mixed.setProgram(mixedParser.parse(SpecializationProgram::value("int64", "1") + SpecializationProgram::value("char", "a") + "add\n" +
+		SpecializationProgram::value("double", "1.5") + SpecializationProgram::value("int64", "2") + "ls\n" +
+		SpecializationProgram::value("bool", "true") + SpecializationProgram::value("bool", "false") + "equ\n"));
+	Analyzer mixedAnalyzer(&mixed);
+	mixedAnalyzer.analyze(mixed.program());
+	check(mixedAnalyzer.specialize(mixed.program()) == 0, "sites with differing operand types aren't specialized");
+	check(mixed.program()[2].opCode() == OpCode::add_ && mixed.program()[5].opCode() == OpCode::ls_ && mixed.program()[8].opCode() == OpCode::equ_,
+		"differing sites keep their generic opcodes");
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testStraightLine();
+	testNestedCalls();
+	testFunctionValue();
+	testLoopWithInit();
+	testUnbounded();
+	testBoundedRuns();
+	testSpecialization();
+	return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#if !defined BPL_TEST_H
+#define BPL_TEST_H
+
+// helpers shared by the test executables, each of which has its own main() and returns failures()
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <functional>
+#include <stdexcept>
+
+#include "interpreter/processor.h"
+#include "interpreter/parser.h"
+#include "interpreter/analyzer.h"
+
+inline int& failures()
+{
+	static int count = 0;
+	return count;
+}
+
+inline void check(bool ok, const std::string& what)
+{
+	if(ok)
+		return;
+	std::cerr << "FAILED: " << what << std::endl;
+	++failures();
+}
+
+inline bool throws(const std::function<void()>& body)
+{
+	try
+	{
+		body();
+	}
+	catch(const std::exception&)
+	{
+		return true;
+	}
+	return false;
+}
+
+// runs proc's program with std::cout captured, returns what it printed
+inline std::string runCaptured(Processor& proc)
+{
+	std::ostringstream out;
+	std::streambuf* old = std::cout.rdbuf(out.rdbuf());
+	try
+	{
+		proc.run();
+	}
+	catch(...)
+	{
+		std::cout.rdbuf(old);
+		throw;
+	}
+	std::cout.rdbuf(old);
+	return out.str();
+}
+
+// parses and runs source on a fresh Processor; analyzed programs are specialized and run on a stack sized by the bounds
+inline std::string runSource(const std::string& source, bool analyzed = false)
+{
+	Processor proc(1 << 20);
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	if(analyzed)
+	{
+		Analyzer analyzer(&proc);
+		std::optional<StackBounds> bounds = analyzer.analyze(proc.program());
+		analyzer.specialize(proc.program());
+		if(bounds.has_value())
+		{
+			proc.reserveStack(bounds->bytes(), bounds->elements(), bounds->operands());
+			proc.setStackBounded(true);
+		}
+	}
+	return runCaptured(proc);
+}
+
+// sources of common statements: array[index] = value, push array[index], call with pushed arguments, define a function value
+inline std::string setElementSource(const std::string& array, int64_t index, const std::string& value)
+{
+	return "get\nvariable:" + array + "\nvalfromarg\nvalue:int64:" + std::to_string(index) + "\ngetSublink\nvalfromarg\nvalue:" + value + "\nset\n";
+}
+
+inline std::string setElementSource(const std::string& array, int64_t index, int64_t value)
+{
+	return setElementSource(array, index, "int64:" + std::to_string(value));
+}
+
+inline std::string elementSource(const std::string& array, int64_t index)
+{
+	return "get\nvariable:" + array + "\nvalfromarg\nvalue:int64:" + std::to_string(index) + "\ngetSublink\nvalfromstlink\n";
+}
+
+inline std::string callSource(const std::string& function, const std::string& arguments)
+{
+	return arguments + "get\nvariable:" + function + "\nvalfromstlink\ncall\n";
+}
+
+inline std::string functionSource(const std::string& name, const std::string& signature, const std::string& body)
+{
+	return "get\nvariable:" + name + "\nvalfromarg\nvalue:function:" + signature + "\n" + body + "end\nset\n";
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "../bpl_test.h"
+
+#include <cstring>
+
+// the natural and packed forms of {char tag; {char c; int64 x} in; double d}
+static void addStructs(Processor& proc)
+{
+	TypeVariant charType(proc.charType());
+	TypeVariant int64Type(proc.int64Type());
+	TypeVariant doubleType(proc.doubleType());
+	for(StructLayout layout : {StructLayout::natural, StructLayout::packed})
+	{
+		std::string suffix = layout == StructLayout::natural ? "N" : "P";
+		proc.addStruct(StructType({charType, int64Type}, {"c", "x"}, layout), "inner" + suffix);
+		proc.addStruct(StructType({charType, proc.typeByName("inner" + suffix).value(), doubleType}, {"tag", "in", "d"}, layout), "outer" + suffix);
+	}
+}
+
+static const char* fieldProgram = R"(init:n
+type:outerN
+init:p
+type:outerP
+getField:in.x
+variable:n
+valfromarg
+value:int64:42
+set
+getField:in.x
+variable:p
+valfromarg
+value:int64:-7
+set
+getField:tag
+variable:p
+valfromarg
+value:char:t
+set
+getField:in.x
+variable:n
+valfromstlink
+printNum
+getField:in.x
+variable:p
+valfromstlink
+printNum
+)";
+
+static size_t fieldOffset(const Instruction& inst) // constant offset from the frame base resolved by the parser
+{
+	return std::get<int64_t>(std::get<Value>(inst.arguments()[1]));
+}
+
+static void testGetField()
+{
+	Processor proc;
+	addStructs(proc);
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(fieldProgram));
+	const FrameLayout& frame = proc.globalFrame();
+	size_t natural = frame.slotOffset(0);
+	size_t packed = frame.slotOffset(1);
+	check(proc.program()[0].opCode() == OpCode::getField_ && fieldOffset(proc.program()[0]) == natural + 8 + 8, "natural nested field offset");
+	check(fieldOffset(proc.program()[3]) == packed + 1 + 1, "packed nested field offset");
+	check(fieldOffset(proc.program()[6]) == packed, "first field offset");
+	check(std::get<TypeVariant>(proc.program()[0].arguments()[2]) == TypeVariant(LinkType(TypeVariant(proc.int64Type()))), "field link type");
+
+	check(runCaptured(proc) == "42-7", "nested fields read back");
+	const uint8_t* base = proc.stack().at(0).value();
+	int64_t naturalX, packedX;
+	memcpy(&naturalX, base + natural + 16, sizeof(naturalX));
+	memcpy(&packedX, base + packed + 2, sizeof(packedX));
+	check(naturalX == 42 && packedX == -7 && base[packed] == 't', "fields are written at their layout offsets");
+}
+
+static void testGetFieldErrors()
+{
+	auto parseWith = [](const std::string& source)
+	{
+		Processor proc;
+		addStructs(proc);
+		Parser parser(&proc);
+		proc.setProgram(parser.parse(source));
+	};
+	check(throws([&]() { parseWith("init:n\ntype:outerN\ngetField:in.y\nvariable:n\n"); }), "unknown nested field name");
+	check(throws([&]() { parseWith("init:n\ntype:outerN\ngetField:missing\nvariable:n\n"); }), "unknown field name");
+	check(throws([&]() { parseWith("init:n\ntype:outerN\ngetField:tag.c\nvariable:n\n"); }), "field of a non-struct field");
+	check(throws([&]() { parseWith("init:n\ntype:outerN\ngetField:in.x\nvariable:m\n"); }), "unknown variable");
+	check(!throws([&]() { parseWith("init:n\ntype:outerN\ngetField:in.c\nvariable:n\n"); }), "known nested field parses");
+}
+
+static std::string pushInt(int64_t value) { return "valfromarg\nvalue:int64:" + std::to_string(value) + "\n"; }
+
+// m is int64[2][3][4]: 4 outer arrays of 3 arrays of 2, so getSublink:3 takes i in 1..4, j in 1..3, k in 1..2
+static std::string sublinksSource(const std::string& reads)
+{
+	std::string source = "init:m\ntype:int64[2][3][4]\n";
+	for(int64_t i = 1; i <= 4; ++i)
+		for(int64_t j = 1; j <= 3; ++j)
+			for(int64_t k = 1; k <= 2; ++k)
+				source += "get\nvariable:m\n" + pushInt(i) + pushInt(j) + pushInt(k) + "getSublink:3\n" + pushInt(i * 100 + j * 10 + k) + "set\n";
+	return source + reads;
+}
+
+static void testGetSublinks()
+{
+	Processor proc;
+	Parser parser(&proc);
+	// reads back with getSublink:3 and with three single getSublink steps
+	proc.setProgram(parser.parse(sublinksSource("get\nvariable:m\n" + pushInt(3) + pushInt(2) + pushInt(1) + "getSublink:3\nvalfromstlink\nprintNum\n" +
+		"get\nvariable:m\n" + pushInt(3) + "getSublink\n" + pushInt(2) + "getSublink\n" + pushInt(1) + "getSublink\nvalfromstlink\nprintNum\n" +
+		"get\nvariable:m\n" + pushInt(4) + pushInt(3) + "getSublink:2\n" + pushInt(2) + "getSublink\nvalfromstlink\nprintNum\n")));
+	check(runCaptured(proc) == "321321432", "getSublink:N reads what it wrote, like single getSublink steps");
+	const uint8_t* base = proc.stack().at(0).value() + proc.globalFrame().slotOffset(0);
+	bool inOrder = true;
+	for(int64_t i = 1; i <= 4; ++i)
+		for(int64_t j = 1; j <= 3; ++j)
+			for(int64_t k = 1; k <= 2; ++k)
+			{
+				int64_t value;
+				memcpy(&value, base + (((i - 1) * 3 + (j - 1)) * 2 + (k - 1)) * sizeof(int64_t), sizeof(value));
+				inOrder = inOrder && value == i * 100 + j * 10 + k;
+			}
+	check(inOrder, "the first index selects the outermost array");
+}
+
+static void testGetSublinksErrors()
+{
+	auto runWith = [](const std::string& reads)
+	{
+		Processor proc;
+		Parser parser(&proc);
+		proc.setProgram(parser.parse(sublinksSource(reads)));
+		runCaptured(proc);
+	};
+	auto outOfRange = [&](const std::string& reads)
+	{
+		try
+		{
+			runWith(reads);
+		}
+		catch(const std::out_of_range&)
+		{
+			return true;
+		}
+		catch(const std::exception&)
+		{
+		}
+		return false;
+	};
+	std::string read = "get\nvariable:m\n";
+	check(!throws([&]() { runWith(read + pushInt(4) + pushInt(3) + pushInt(2) + "getSublink:3\n"); }), "last element is in range");
+	check(outOfRange(read + pushInt(5) + pushInt(1) + pushInt(1) + "getSublink:3\n"), "outer index past the end");
+	check(outOfRange(read + pushInt(1) + pushInt(4) + pushInt(1) + "getSublink:3\n"), "middle index past the end");
+	check(outOfRange(read + pushInt(1) + pushInt(1) + pushInt(3) + "getSublink:3\n"), "inner index past the end");
+	check(outOfRange(read + pushInt(1) + pushInt(0) + pushInt(1) + "getSublink:3\n"), "index 0 is out of range");
+	check(throws([&]() { runWith(read + pushInt(1) + pushInt(1) + pushInt(1) + pushInt(1) + "getSublink:4\n"); }), "more indices than dimensions");
+	check(throws([&]() { runWith(read + "getSublink:0\n"); }), "index count must be positive");
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testGetField();
+	testGetFieldErrors();
+	testGetSublinks();
+	testGetSublinksErrors();
+	return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "../bpl_test.h"
+
+#include <cstring>
+
+// g holds 5 at index 2, f returns a[2] of its by-value argument
+static std::string readerSource(size_t count)
+{
+	std::string array = "int64[" + std::to_string(count) + "]";
+	return "init:g\ntype:" + array + "\ninit:f\ntype:int64(" + array + ")\n" + setElementSource("g", 2, 5) +
+		functionSource("f", "int64:" + array + " a", elementSource("a", 2) + "ret\n") + callSource("f", "get\nvariable:g\nvalfromstlink\n") + "printNum\n";
+}
+
+// bytes of the argument slot of the first function called from the top level, left on the stack after it returned
+static std::vector<uint8_t> calleeArgument(const Processor& proc, size_t size)
+{
+	size_t frameBase = (proc.globalFrame().size() + 7) / 8 * 8;
+	const uint8_t* data = proc.stack().at(0).value() + frameBase;
+	return std::vector<uint8_t>(data, data + size);
+}
+
+static void testReadWithoutCopy()
+{
+	Processor large;
+	Parser largeParser(&large);
+	large.setProgram(largeParser.parse(readerSource(20)));
+	check(runCaptured(large) == "5", "callee reads a borrowed argument");
+	check(calleeArgument(large, 20 * sizeof(int64_t)) == std::vector<uint8_t>(20 * sizeof(int64_t), 0), "borrowed argument isn't copied into the callee frame");
+
+	// small aggregates are still copied, which shows the slot is where the copy would go
+	Processor small;
+	Parser smallParser(&small);
+	small.setProgram(smallParser.parse(readerSource(4)));
+	check(runCaptured(small) == "5", "callee reads a copied argument");
+	std::vector<uint8_t> copied = calleeArgument(small, 4 * sizeof(int64_t));
+	int64_t second;
+	memcpy(&second, copied.data() + sizeof(int64_t), sizeof(second));
+	check(second == 5, "small argument is copied into the callee frame");
+}
+
+static const std::string array20 = "int64[20]";
+
+static void testCopyOnWrite()
+{
+	std::string source = "init:g\ntype:" + array20 + "\ninit:w\ntype:int64(" + array20 + ")\ninit:h\ntype:int64(" + array20 + ")\ninit:f\ntype:int64(" + array20 + ")\n" +
+		setElementSource("g", 2, 5) + functionSource("f", "int64:" + array20 + " a", elementSource("a", 2) + "ret\n") +
+		// w writes its own argument, h writes the caller's value while its argument still borrows it
+		functionSource("w", "int64:" + array20 + " a", setElementSource("a", 2, 9) + elementSource("a", 2) + "ret\n") +
+		functionSource("h", "int64:" + array20 + " a", setElementSource("g", 2, 7) + elementSource("a", 2) + "ret\n") +
+		callSource("w", "get\nvariable:g\nvalfromstlink\n") + "printNum\n" + elementSource("g", 2) + "printNum\n" +
+		callSource("h", "get\nvariable:g\nvalfromstlink\n") + "printNum\n" + elementSource("g", 2) + "printNum\n" +
+		// w, g[2], h, g[2]; then an operand borrowed at the top level keeps 7 when g is written before the call
+		"get\nvariable:g\nvalfromstlink\n" + setElementSource("g", 2, 11) + callSource("f", "") + "printNum\n" + elementSource("g", 2) + "printNum\n";
+	std::string output = runSource(source);
+	check(output == "9557711", "writes on either side copy the borrowed value first, printed " + output);
+}
+
+// outer borrows g, grows the stack through k, then passes its borrowed argument on to inner
+static void testNestedBorrows()
+{
+	std::string source = "init:g\ntype:" + array20 + "\ninit:k\ntype:int64(int64)\ninit:inner\ntype:int64(" + array20 + ")\n" +
+		"init:outer\ntype:int64(" + array20 + ",int64)\n" + setElementSource("g", 2, 5) +
+		functionSource("k", "int64:int64 x", "init:big\ntype:char[1048576]\nget\nvariable:x\nvalfromstlink\nret\n") +
+		// inner re-borrows outer's argument, writes its own copy, and writes g under outer's borrow
+		functionSource("inner", "int64:" + array20 + " a", elementSource("a", 2) + "printNum\n" + setElementSource("a", 3, 1) + setElementSource("g", 2, 8) +
+			elementSource("a", 3) + "ret\n") +
+		functionSource("outer", "int64:" + array20 + " a:int64 n", callSource("k", "get\nvariable:n\nvalfromstlink\n") + "printNum\n" +
+			elementSource("a", 2) + "printNum\n" + callSource("inner", "get\nvariable:a\nvalfromstlink\n") + "printNum\n" + elementSource("a", 3) + "printNum\n" +
+			elementSource("a", 2) + "ret\n") +
+		callSource("outer", "get\nvariable:g\nvalfromstlink\nvalfromarg\nvalue:int64:4\n") + "printNum\n" + elementSource("g", 2) + "printNum\n";
+
+	Processor proc(4096);
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	setAllowResizeStack(true);
+	std::string output;
+	bool threw = throws([&]() { output = runCaptured(proc); });
+	setAllowResizeStack(false);
+	check(!threw, "nested borrows run");
+	check(proc.stack().capacity() > 4096, "the callee grew the stack while the argument was borrowed");
+	// k's result, a[2] after the growth, a[2] in inner, inner's a[3], outer's a[3], outer's a[2], g[2]
+	check(output == "4551058", "borrowed arguments survive stack growth and nested borrows keep by-value semantics, printed " + output);
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testReadWithoutCopy();
+	testCopyOnWrite();
+	testNestedBorrows();
+	return failures() == 0 ? 0 : 1;
+}
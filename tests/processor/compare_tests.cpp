@@ -0,0 +1,202 @@
+#include "../bpl_test.h"
+
+#include <cstring>
+
+typedef std::vector<std::pair<size_t, size_t>> Ranges;
+
+static Ranges rangesOf(const TypeVariant& type)
+{
+	Ranges ranges;
+	type.valueRanges(ranges);
+	return ranges;
+}
+
+static void addPair(Processor& proc) // {char c; int64 x} with 7 padding bytes after c
+{
+	proc.addStruct(StructType({TypeVariant(proc.charType()), TypeVariant(proc.int64Type())}, {"c", "x"}, StructLayout::natural), "pair");
+}
+
+static void testValueRanges()
+{
+	Processor proc;
+	addPair(proc);
+	TypeVariant pair = proc.typeByName("pair").value();
+	TypeVariant int64Type(proc.int64Type());
+	check(rangesOf(pair) == Ranges{{0, 1}, {8, 8}}, "natural struct leaves its padding out");
+	check(rangesOf(TypeVariant(ArrayType(pair, 2))) == Ranges{{0, 1}, {8, 9}, {24, 8}}, "array of padded structs, touching runs merged");
+	check(rangesOf(TypeVariant(ArrayType(TypeVariant(ArrayType(int64Type, 2)), 3))) == Ranges{{0, 48}}, "nested arrays are one run");
+	StructType packed({TypeVariant(proc.charType()), int64Type}, {"c", "x"}, StructLayout::packed);
+	check(rangesOf(TypeVariant(&packed)) == Ranges{{0, 9}}, "packed struct is one run");
+	StructType record({TypeVariant(proc.charType()), TypeVariant(ArrayType(pair, 2))}, {"tag", "v"}, StructLayout::natural);
+	check(rangesOf(TypeVariant(&record)) == Ranges{{0, 1}, {8, 1}, {16, 9}, {32, 8}}, "struct with an array of structs");
+
+	StructType mixed({TypeVariant(proc.charType()), TypeVariant(proc.doubleType()), int64Type}, {"c", "d", "x"}, StructLayout::natural);
+	Ranges bytes, doubles;
+	TypeVariant(ArrayType(TypeVariant(&mixed), 2)).valueRanges(bytes, proc.doubleType(), doubles);
+	check(bytes == Ranges{{0, 1}, {16, 9}, {40, 8}} && doubles == Ranges{{8, 8}, {32, 8}}, "double fields are split off");
+	bytes.clear();
+	doubles.clear();
+	TypeVariant(ArrayType(TypeVariant(proc.doubleType()), 4)).valueRanges(bytes, proc.doubleType(), doubles);
+	check(bytes.empty() && doubles == Ranges{{0, 32}}, "double array is one run of doubles");
+}
+
+static std::string setField(const std::string& variable, const std::string& field, const std::string& value)
+{
+	return "getField:" + field + "\nvariable:" + variable + "\nvalfromarg\nvalue:" + value + "\nset\n";
+}
+
+static std::string setPairElement(const std::string& array, int64_t index, const std::string& c, int64_t x)
+{
+	std::string element = "get\nvariable:" + array + "\nvalfromarg\nvalue:int64:" + std::to_string(index) + "\ngetSublink\n";
+	return element + "valfromarg\nvalue:int64:1\ngetSublink\nvalfromarg\nvalue:char:" + c + "\nset\n" +
+		element + "valfromarg\nvalue:int64:2\ngetSublink\nvalfromarg\nvalue:int64:" + std::to_string(x) + "\nset\n";
+}
+
+static std::string compare(const std::string& result, const std::string& a, const std::string& b, const std::string& op)
+{
+	return "get\nvariable:" + result + "\nget\nvariable:" + a + "\nvalfromstlink\nget\nvariable:" + b + "\nvalfromstlink\n" + op + "\nset\n";
+}
+
+static bool globalBool(const Processor& proc, size_t slot)
+{
+	return proc.stack().at(0).value()[proc.globalFrame().slotOffset(slot)] != 0;
+}
+
+// dirty leaves all ones or zeros in its frame, clean's locals then start on top of them with their padding unwritten
+static void testPaddingIgnored()
+{
+	std::string source = "init:dirty\ntype:int64(int64)\ninit:clean\ntype:int64(int64)\n";
+	for(size_t i = 0; i < 7; ++i)
+		source += "init:r" + std::to_string(i) + "\ntype:bool\n";
+	std::string dirtyBody = "init:junk\ntype:int64[12]\n";
+	for(int64_t i = 1; i <= 12; ++i)
+		dirtyBody += setElementSource("junk", i, (i <= 2 || (i >= 5 && i <= 8)) ? -1 : 0);
+	std::string cleanBody = "init:s1\ntype:pair\ninit:s2\ntype:pair\ninit:p1\ntype:pair[2]\ninit:p2\ntype:pair[2]\n" +
+		setField("s1", "c", "char:x") + setField("s1", "x", "int64:5") + setField("s2", "c", "char:x") + setField("s2", "x", "int64:5") +
+		setPairElement("p1", 1, "a", 1) + setPairElement("p1", 2, "b", 2) + setPairElement("p2", 1, "a", 1) + setPairElement("p2", 2, "b", 2) +
+		compare("r0", "s1", "s2", "equ") + compare("r1", "s1", "s2", "neq") + compare("r2", "p1", "p2", "equ") + compare("r3", "p1", "p2", "neq") +
+		setField("s2", "x", "int64:6") + setPairElement("p2", 2, "c", 2) +
+		compare("r4", "s1", "s2", "equ") + compare("r5", "s1", "s2", "neq") + compare("r6", "p1", "p2", "equ") +
+		"get\nvariable:m\nvalfromstlink\nret\n";
+	source += functionSource("dirty", "int64:int64 n", dirtyBody + "get\nvariable:n\nvalfromstlink\nret\n") + functionSource("clean", "int64:int64 m", cleanBody) +
+		callSource("dirty", "valfromarg\nvalue:int64:1\n") + callSource("clean", "valfromarg\nvalue:int64:2\n") + "printNum\n";
+
+	Processor proc;
+	addPair(proc);
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	check(runCaptured(proc) == "2", "padding program runs");
+
+	// both frames started at the same position, right after the globals
+	const uint8_t* frame = proc.stack().at(0).value() + (proc.globalFrame().size() + 7) / 8 * 8;
+	auto padding = [frame](size_t offset, uint8_t byte)
+	{
+		for(size_t i = offset + 1; i < offset + 8; ++i)
+		{
+			if(frame[i] != byte)
+				return false;
+		}
+		return true;
+	};
+	check(padding(8, 0xff) && padding(24, 0) && padding(40, 0xff) && padding(56, 0xff) && padding(72, 0) && padding(88, 0),
+		"compared values differ in their padding");
+	// r0..r6 follow the two function slots
+	check(globalBool(proc, 2) && !globalBool(proc, 3), "structs equal apart from padding");
+	check(globalBool(proc, 4) && !globalBool(proc, 5), "arrays of structs equal apart from padding");
+	check(!globalBool(proc, 6) && globalBool(proc, 7), "structs with a different field");
+	check(!globalBool(proc, 8), "arrays of structs with a different field");
+}
+
+static void testNestedArrays()
+{
+	std::string source = "init:a\ntype:int64[2][3]\ninit:b\ntype:int64[2][3]\ninit:r0\ntype:bool\ninit:r1\ntype:bool\ninit:r2\ntype:bool\ninit:r3\ntype:bool\n";
+	for(int64_t i = 1; i <= 3; ++i)
+		for(int64_t j = 1; j <= 2; ++j)
+			for(const char* array : {"a", "b"})
+				source += std::string("get\nvariable:") + array + "\nvalfromarg\nvalue:int64:" + std::to_string(i) + "\nvalfromarg\nvalue:int64:" +
+					std::to_string(j) + "\ngetSublink:2\nvalfromarg\nvalue:int64:" + std::to_string(i * 10 + j) + "\nset\n";
+	source += compare("r0", "a", "b", "equ") + compare("r1", "a", "b", "neq") +
+		"get\nvariable:b\nvalfromarg\nvalue:int64:3\nvalfromarg\nvalue:int64:2\ngetSublink:2\nvalfromarg\nvalue:int64:0\nset\n" +
+		compare("r2", "a", "b", "equ") + compare("r3", "a", "b", "neq");
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	runCaptured(proc);
+	check(globalBool(proc, 2) && !globalBool(proc, 3), "equal nested arrays");
+	check(!globalBool(proc, 4) && globalBool(proc, 5), "nested arrays differing in the last element");
+
+	check(throws([]() { runSource("init:a\ntype:int64[2][3]\ninit:b\ntype:int64[2][3]\ninit:r\ntype:bool\n" + compare("r", "a", "b", "ls")); }),
+		"int64 arrays have no order");
+	check(throws([]() { runSource("init:a\ntype:int64[2][3]\ninit:b\ntype:int64[3][2]\ninit:r\ntype:bool\n" + compare("r", "a", "b", "equ")); }),
+		"arrays of different shapes don't compare");
+}
+
+// equ and neq compare double fields by value like scalar equ: -0.0 equals 0.0, NaN equals nothing, even the same bits
+static void testDoubleFields()
+{
+	const std::vector<std::pair<std::string, std::string>> values{{"-0", "0"}, {"nan", "nan"}, {"1.5", "1.5"}, {"1.5", "2.5"}};
+	for(const std::pair<std::string, std::string>& value : values)
+	{
+		std::string source = "init:s1\ntype:pair\ninit:s2\ntype:pair\ninit:a\ntype:double[3]\ninit:b\ntype:double[3]\n";
+		for(size_t i = 0; i < 5; ++i)
+			source += "init:r" + std::to_string(i) + "\ntype:bool\n";
+		source += setField("s1", "c", "char:x") + setField("s1", "d", "double:" + value.first) + setField("s2", "c", "char:x") +
+			setField("s2", "d", "double:" + value.second) + setElementSource("a", 2, "double:" + value.first) + setElementSource("b", 2, "double:" + value.second) +
+			compare("r0", "s1", "s2", "equ") + compare("r1", "s1", "s2", "neq") + compare("r2", "a", "b", "equ") + compare("r3", "a", "b", "neq") +
+			"get\nvariable:r4\n" + elementSource("a", 2) + elementSource("b", 2) + "equ\nset\n";
+		Processor proc;
+		proc.addStruct(StructType({TypeVariant(proc.charType()), TypeVariant(proc.doubleType())}, {"c", "d"}, StructLayout::natural), "pair");
+		Parser parser(&proc);
+		proc.setProgram(parser.parse(source));
+		runCaptured(proc);
+		bool expected = std::stod(value.first) == std::stod(value.second);
+		std::string what = value.first + " and " + value.second;
+		check(globalBool(proc, 8) == expected, "scalar equ of " + what);
+		check(globalBool(proc, 4) == expected && globalBool(proc, 5) != expected, "struct double fields " + what);
+		check(globalBool(proc, 6) == expected && globalBool(proc, 7) != expected, "double array elements " + what);
+	}
+}
+
+static std::string word(const std::string& array, const std::string& letters) // char[4], zero filled past the letters
+{
+	std::string source;
+	for(size_t i = 0; i < letters.size(); ++i)
+		source += setElementSource(array, i + 1, std::string("char:") + letters[i]);
+	return source;
+}
+
+// ls, leq, bg, beq of char arrays order them like strcmp, a prefix first
+static void testCharOrder()
+{
+	const std::vector<std::pair<std::string, std::string>> pairs{{"ab", "abc"}, {"abc", "ab"}, {"abc", "abd"}, {"abd", "abc"}, {"abc", "abc"},
+		{"b", "abcd"}, {"", "a"}, {"Z", "a"}};
+	const std::vector<std::string> ops{"ls", "leq", "bg", "beq", "equ", "neq"};
+	for(const std::pair<std::string, std::string>& words : pairs)
+	{
+		std::string source = "init:a\ntype:char[4]\ninit:b\ntype:char[4]\n";
+		for(size_t i = 0; i < ops.size(); ++i)
+			source += "init:r" + std::to_string(i) + "\ntype:bool\n";
+		source += word("a", words.first) + word("b", words.second);
+		for(size_t i = 0; i < ops.size(); ++i)
+			source += compare("r" + std::to_string(i), "a", "b", ops[i]);
+		Processor proc;
+		Parser parser(&proc);
+		proc.setProgram(parser.parse(source));
+		runCaptured(proc);
+		int order = strcmp(words.first.c_str(), words.second.c_str());
+		const bool expected[] = {order < 0, order <= 0, order > 0, order >= 0, order == 0, order != 0};
+		for(size_t i = 0; i < ops.size(); ++i)
+			check(globalBool(proc, i + 2) == expected[i], "\"" + words.first + "\" " + ops[i] + " \"" + words.second + "\"");
+	}
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testValueRanges();
+	testPaddingIgnored();
+	testNestedArrays();
+	testDoubleFields();
+	testCharOrder();
+	return failures() == 0 ? 0 : 1;
+}
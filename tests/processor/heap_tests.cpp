@@ -0,0 +1,55 @@
+#include "../bpl_test.h"
+
+// p = alloc type, then push p's value for every statement in uses
+static std::string pointerSource(const std::string& alloc, const std::string& uses)
+{
+	return "init:p\ntype:int64*\nget\nvariable:p\n" + alloc + "\ntype:int64\nset\n" + uses;
+}
+
+static const std::string freeSource = "get\nvariable:p\nvalfromstlink\nfree\n";
+
+static bool runThrows(const std::string& source, ValidationLevel level)
+{
+	setValidationLevel(level);
+	bool threw = throws([&]() { runSource(source); });
+	setValidationLevel(ValidationLevel::full);
+	return threw;
+}
+
+static void testDoubleFree()
+{
+	check(!runThrows(pointerSource("alloc", freeSource), ValidationLevel::light), "a single free runs");
+	check(runThrows(pointerSource("alloc", freeSource + freeSource), ValidationLevel::light), "freeing a value twice throws under light validation");
+	// the block is handed out again between the frees, so the second one frees the new value
+	check(!runThrows(pointerSource("alloc", freeSource + "get\nvariable:p\nalloc\ntype:int64\nset\n" + freeSource), ValidationLevel::light),
+		"freeing a reused block runs");
+}
+
+static void testFreeRegionValue()
+{
+	check(runThrows(pointerSource("alloc:region", freeSource), ValidationLevel::basic), "freeing a region value throws under basic validation");
+}
+
+// p is set in an if body, so its region value is released when the body's level is popped
+static std::string levelSource(const std::string& body, const std::string& after)
+{
+	return "init:p\ntype:int64*\nif\ninstructions\nvalfromarg\nvalue:int64:1\nvalfromarg\nvalue:int64:1\nequ\nendInstructions\ninstructions\n"
+		"get\nvariable:p\nalloc:region\ntype:int64\nset\n" + body + "endInstructions\n" + after;
+}
+
+static const std::string derefSource = "get\nvariable:p\nvalfromstlink\nderef\nvalfromstlink\nprintNum\n";
+
+static void testDerefReleasedRegionValue()
+{
+	check(!runThrows(levelSource(derefSource, ""), ValidationLevel::light), "a region value is read in its level");
+	check(runThrows(levelSource("", derefSource), ValidationLevel::light), "reading a region value after its level was popped throws under light validation");
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testDoubleFree();
+	testFreeRegionValue();
+	testDerefReleasedRegionValue();
+	return failures() == 0 ? 0 : 1;
+}
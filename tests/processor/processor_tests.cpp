@@ -1,19 +1,155 @@
 #include <iostream>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
 
 #include "interpreter/processor.h"
 
+static size_t allocations = 0;
+static bool countAllocations = false;
+
+void* operator new(size_t size)
+{
+	if(countAllocations)
+		++allocations;
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if(memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+// heap allocations made by run() of a loop doing iterations rounds of get/set/valfromstlink/valfromarg/add/ls/call/ret
+size_t loopAllocations(int64_t iterations)
+{
+	Processor proc(1 << 20);
+	TypeVariant int64Type(proc.int64Type());
+	FunctionType incType(std::vector<TypeVariant>{int64Type}, int64Type);
+	Function inc(incType, std::vector<Instruction>
+	{
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(1))}),
+		Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+		Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(int64_t(1)))}),
+		Instruction(OpCode::add_, std::vector<Argument>{}),
+		Instruction(OpCode::ret_, std::vector<Argument>{})
+	});
+	std::vector<Instruction> prog
+	{
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(int64Type)}),
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(int64Type)}),
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(incType))}),
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(2, true))}),
+		Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(inc))}),
+		Instruction(OpCode::set_, std::vector<Argument>{}),
+		Instruction(OpCode::while_, std::vector<Argument>{Argument(std::vector<Instruction>
+			{
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(iterations))}),
+				Instruction(OpCode::ls_, std::vector<Argument>{})
+			}),
+			Argument(std::vector<Instruction>
+			{
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(1, true))}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(1, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::add_, std::vector<Argument>{}),
+				Instruction(OpCode::set_, std::vector<Argument>{}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(2, true))}),
+				Instruction(OpCode::valfromstlink_, std::vector<Argument>{}),
+				Instruction(OpCode::call_, std::vector<Argument>{}),
+				Instruction(OpCode::set_, std::vector<Argument>{})
+			})
+		})
+	};
+	proc.setProgram(std::move(prog));
+	TypeTable::instance().intern(int64Type); // types of a new Processor may be new to the TypeTable, keep their first interning out of the count
+	TypeTable::instance().intern(TypeVariant(incType));
+	allocations = 0;
+	countAllocations = true;
+	proc.run();
+	countAllocations = false;
+	return allocations;
+}
+
 int main(/*int argc, char** argv*/)
 {
+	for(ValidationLevel level : {ValidationLevel::none, ValidationLevel::full})
+	{
+		setValidationLevel(level);
+		size_t shortRun = loopAllocations(10);
+		size_t longRun = loopAllocations(1010);
+		if(longRun > shortRun) // startup allocations are the same for both, so any difference comes from the loop
+		{
+			std::cerr << "hot opcodes allocated " << longRun - shortRun << " times in 1000 iterations" << std::endl;
+			return 1;
+		}
+	}
+
+	Heap heap;
+	uint8_t* first = heap.allocate(24);
+	uint8_t* second = heap.allocate(24);
+	heap.deallocate(first, 24);
+	if(heap.allocate(20) != first || second - first != 32 || heap.liveBlocks() != 2) // same 32 byte class, block reused
+	{
+		std::cerr << "heap doesn't reuse freed blocks of a size class" << std::endl;
+		return 1;
+	}
+
+	setValidationLevel(ValidationLevel::light);
+	heap.deallocate(second, 24);
+	bool doubleFree = false;
+	try
+	{
+		heap.deallocate(second, 24);
+	}
+	catch(const std::invalid_argument&)
+	{
+		doubleFree = true;
+	}
+	if(!doubleFree || heap.liveBlocks() != 1 || heap.allocate(24) != second || heap.allocate(24) == second)
+	{
+		std::cerr << "heap doesn't reject a block freed twice" << std::endl;
+		return 1;
+	}
+
+	Region region;
+	uint8_t* kept = region.allocate(8);
+	Region::Mark mark = region.mark();
+	uint8_t* scratch = region.allocate(Region::chunkSize); // doesn't fit the first chunk
+	region.allocate(100);
+	region.release(mark);
+	if(region.owns(scratch) || region.allocate(100) != kept + Heap::minBlockSize)
+	{
+		std::cerr << "region keeps memory allocated after its mark" << std::endl;
+		return 1;
+	}
+	Region::Mark tailMark = region.mark();
+	uint8_t* tail = region.allocate(32);
+	region.release(tailMark);
+	if(!region.released(scratch) || !region.released(tail) || region.released(kept) || region.released(kept + Heap::minBlockSize))
+	{
+		std::cerr << "region doesn't tell released memory from live memory" << std::endl;
+		return 1;
+	}
+
 	setValidationLevel(ValidationLevel::basic);
 	Processor proc(1 << 20);
 	/*std::vector<Instruction> prog
 	{
 		Instruction(OpCode::init_, std::vector<Argument>{Argument(
-			FunctionType(std::vector<TypeVariant>{}, TypeVariant(&proc.baseTypes()["void"])) 
+			FunctionType(std::vector<TypeVariant>{}, TypeVariant(proc.baseTypes()["void"])) 
 		)}),
 		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
 		Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value(Function( 
-			FunctionType(std::vector<TypeVariant>{}, TypeVariant(&proc.baseTypes()["void"])), 
+			FunctionType(std::vector<TypeVariant>{}, TypeVariant(proc.baseTypes()["void"])), 
 			std::vector<Instruction>
 			{
 				Instruction(OpCode::valfromarg_, std::vector<Argument>{Argument(Value('H'))}),
@@ -56,9 +192,18 @@ int main(/*int argc, char** argv*/)
 
 	std::vector<Instruction> prog
 	{
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(proc.baseTypes()["int64"]))}),
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(proc.baseTypes()["char"]))}),
+		Instruction(OpCode::init_, std::vector<Argument>{Argument(TypeVariant(proc.baseTypes()["int64"]))}),
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(0, true))}),
 		Instruction(OpCode::readNum_, std::vector<Argument>{}),
+		Instruction(OpCode::set_, std::vector<Argument>{}),
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(1, true))}),
 		Instruction(OpCode::readCh_, std::vector<Argument>{}),
+		Instruction(OpCode::set_, std::vector<Argument>{}),
+		Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(2, true))}),
 		Instruction(OpCode::readNum_, std::vector<Argument>{}),
+		Instruction(OpCode::set_, std::vector<Argument>{}),
 		Instruction(OpCode::if_, std::vector<Argument>{Argument(std::vector<Instruction>
 			{
 				Instruction(OpCode::get_, std::vector<Argument>{Argument(PreStackIndex(1, true))}),
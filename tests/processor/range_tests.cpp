@@ -0,0 +1,144 @@
+#include "../bpl_test.h"
+
+#include <cstring>
+
+static std::string pushInt(int64_t value) { return "valfromarg\nvalue:int64:" + std::to_string(value) + "\n"; }
+
+// a is an int64 array holding 1..length, then the statements run; returns a afterwards
+static std::vector<int64_t> runOnSequence(size_t length, const std::string& statements)
+{
+	std::string source = "init:a\ntype:int64[" + std::to_string(length) + "]\ninit:b\ntype:int64[4]\n";
+	for(size_t i = 1; i <= length; ++i)
+		source += setElementSource("a", i, static_cast<int64_t>(i));
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source + statements));
+	runCaptured(proc);
+	std::vector<int64_t> result(length);
+	memcpy(result.data(), proc.stack().at(0).value() + proc.globalFrame().slotOffset(0), length * sizeof(int64_t));
+	return result;
+}
+
+static std::vector<int64_t> sequence(size_t length)
+{
+	std::vector<int64_t> values;
+	for(size_t i = 1; i <= length; ++i)
+		values.push_back(static_cast<int64_t>(i));
+	return values;
+}
+
+static std::string copyRange(const std::string& destination, int64_t destinationStart, const std::string& source, int64_t sourceStart, int64_t count)
+{
+	return "get\nvariable:" + destination + "\n" + pushInt(destinationStart) + "get\nvariable:" + source + "\n" + pushInt(sourceStart) + pushInt(count) +
+		"copyRange\n";
+}
+
+static std::string fillRange(const std::string& array, int64_t start, int64_t count, const std::string& value)
+{
+	return "get\nvariable:" + array + "\n" + pushInt(start) + pushInt(count) + "valfromarg\nvalue:" + value + "\nfillRange\n";
+}
+
+// copies within one array behave like memmove in both directions
+static void testOverlappingCopy()
+{
+	const size_t length = 20;
+	for(int64_t destination : {1, 2, 3, 7, 11})
+		for(int64_t source : {1, 2, 5, 9})
+			for(int64_t count : {1, 3, 8, 10})
+			{
+				if(destination + count - 1 > static_cast<int64_t>(length) || source + count - 1 > static_cast<int64_t>(length))
+					continue;
+				std::vector<int64_t> expected = sequence(length);
+				memmove(expected.data() + destination - 1, expected.data() + source - 1, count * sizeof(int64_t));
+				check(runOnSequence(length, copyRange("a", destination, "a", source, count)) == expected,
+					"copyRange a[" + std::to_string(destination) + "] <- a[" + std::to_string(source) + "] x" + std::to_string(count));
+			}
+	std::vector<int64_t> expected = sequence(length);
+	expected[0] = expected[1] = 0;
+	check(runOnSequence(length, copyRange("a", 1, "b", 3, 2)) == expected, "copyRange from another array");
+}
+
+static void testZeroCount()
+{
+	const size_t length = 8;
+	check(runOnSequence(length, copyRange("a", 3, "a", 1, 0) + fillRange("a", 2, 0, "int64:9")) == sequence(length), "zero count changes nothing");
+	check(runOnSequence(length, copyRange("a", 9, "a", 9, 0) + fillRange("a", 9, 0, "int64:9")) == sequence(length), "zero count right past the end");
+	check(throws([&]() { runOnSequence(length, fillRange("a", 10, 0, "int64:9")); }), "zero count further past the end");
+	check(throws([&]() { runOnSequence(length, copyRange("a", 0, "a", 1, 0)); }), "zero count at index 0");
+}
+
+static void testRangeErrors()
+{
+	const size_t length = 8;
+	auto outOfRange = [&](const std::string& statements)
+	{
+		try
+		{
+			runOnSequence(length, statements);
+		}
+		catch(const std::out_of_range&)
+		{
+			return true;
+		}
+		catch(const std::exception&)
+		{
+		}
+		return false;
+	};
+	check(outOfRange(fillRange("a", 0, 1, "int64:9")), "fill start 0");
+	check(outOfRange(fillRange("a", 9, 1, "int64:9")), "fill start past the end");
+	check(outOfRange(fillRange("a", 5, 5, "int64:9")), "fill count past the end");
+	check(outOfRange(fillRange("a", 1, -1, "int64:9")), "negative fill count");
+	check(outOfRange(fillRange("a", 2, INT64_MAX, "int64:9")), "huge fill count");
+	check(outOfRange(fillRange("a", INT64_MIN, 1, "int64:9")), "negative fill start");
+	check(outOfRange(copyRange("a", 6, "a", 1, 4)), "copy destination past the end");
+	check(outOfRange(copyRange("a", 1, "a", 6, 4)), "copy source past the end");
+	check(outOfRange(copyRange("a", 1, "b", 2, 4)), "copy source past the end of the shorter array");
+	check(outOfRange(copyRange("a", 1, "a", 1, -2)), "negative copy count");
+	check(!outOfRange(copyRange("a", 5, "a", 1, 4)), "copy up to the last element");
+	check(throws([&]() { runOnSequence(length, fillRange("a", 1, 1, "double:1.5")); }), "fill value of another type");
+	check(throws([&]() { runOnSequence(length, "init:c\ntype:char[8]\n" + copyRange("a", 1, "c", 1, 1)); }), "copy between element types");
+}
+
+// a fill leaves everything outside its range alone, for counts around the memset and doubling memcpy steps
+template<typename T>
+static void checkFill(const std::string& typeName, const std::string& value, T filled, T sentinel, const std::string& sentinelValue)
+{
+	const size_t length = 40;
+	std::string declarations = "init:a\ntype:" + typeName + "[" + std::to_string(length) + "]\n";
+	std::string prefill;
+	for(size_t i = 1; i <= length; ++i)
+		prefill += setElementSource("a", i, typeName + ":" + sentinelValue);
+	for(int64_t start : {1, 2, 3, 5, 8})
+		for(int64_t count : {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33})
+		{
+			if(start + count - 1 > static_cast<int64_t>(length))
+				continue;
+			Processor proc;
+			Parser parser(&proc);
+			proc.setProgram(parser.parse(declarations + prefill + fillRange("a", start, count, typeName + ":" + value)));
+			runCaptured(proc);
+			std::vector<T> array(length);
+			memcpy(array.data(), proc.stack().at(0).value() + proc.globalFrame().slotOffset(0), length * sizeof(T));
+			std::vector<T> expected(length, sentinel);
+			std::fill(expected.begin() + start - 1, expected.begin() + start - 1 + count, filled);
+			check(array == expected, typeName + " fill from " + std::to_string(start) + " x" + std::to_string(count));
+		}
+}
+
+static void testFill()
+{
+	checkFill<int64_t>("int64", "-3", -3, 7, "7");
+	checkFill<double>("double", "2.5", 2.5, -1.0, "-1");
+	checkFill<char>("char", "z", 'z', '.', ".");
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testOverlappingCopy();
+	testZeroCount();
+	testRangeErrors();
+	testFill();
+	return failures() == 0 ? 0 : 1;
+}
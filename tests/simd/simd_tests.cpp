@@ -0,0 +1,374 @@
+#include "../bpl_test.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+
+#include "interpreter/simd.h"
+
+// covers 1, lane - 1, lane, lane + 1 for 2 and 4 lanes, and odd tails after several full vectors
+static const std::vector<size_t> lengths{1, 2, 3, 4, 5, 7, 8, 9, 13, 33};
+
+static std::vector<SimdLevel> supportedLevels()
+{
+	std::vector<SimdLevel> levels;
+	for(SimdLevel level : {SimdLevel::scalar, SimdLevel::sse2, SimdLevel::avx2})
+	{
+		if(level <= detectedSimdLevel())
+			levels.push_back(level);
+	}
+	return levels;
+}
+
+static std::string levelName(SimdLevel level)
+{
+	return level == SimdLevel::scalar ? "scalar" : level == SimdLevel::sse2 ? "sse2" : "avx2";
+}
+
+static std::string literal(int64_t value) { return std::to_string(value); }
+static std::string literal(char value) { return std::string(1, value); }
+static std::string literal(double value)
+{
+	if(std::isnan(value))
+		return "nan";
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.17g", value);
+	return buffer;
+}
+
+template<typename T> static std::string typeName();
+template<> std::string typeName<int64_t>() { return "int64"; }
+template<> std::string typeName<char>() { return "char"; }
+template<> std::string typeName<double>() { return "double"; }
+
+template<typename T>
+static std::string fill(const std::string& array, const std::vector<T>& values)
+{
+	std::string source;
+	for(size_t i = 0; i < values.size(); ++i)
+		source += "get\nvariable:" + array + "\nvalfromarg\nvalue:int64:" + std::to_string(i + 1) + "\ngetSublink\nvalfromarg\nvalue:" +
+			typeName<T>() + ":" + literal(values[i]) + "\nset\n";
+	return source;
+}
+
+// deterministic inputs with repeats, so compares see equal, smaller and bigger pairs
+static std::vector<int64_t> int64Values(size_t count, int64_t seed)
+{
+	std::vector<int64_t> values;
+	uint64_t state = seed;
+	for(size_t i = 0; i < count; ++i)
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		int64_t value = static_cast<int64_t>(state >> 40) % 7 - 3;
+		values.push_back(i % 5 == 4 ? static_cast<int64_t>(state) : value); // some large values make mul wrap
+	}
+	return values;
+}
+
+static std::vector<double> doubleValues(size_t count, int64_t seed, bool withNaN)
+{
+	std::vector<double> values;
+	for(int64_t value : int64Values(count, seed))
+		values.push_back(static_cast<double>(value % 1000) / 4);
+	for(size_t i = 0; withNaN && i < count; i += 3)
+		values[i] = i % 2 == 0 ? std::numeric_limits<double>::quiet_NaN() : -0.0;
+	return values;
+}
+
+static std::vector<char> charValues(size_t count)
+{
+	std::vector<char> values;
+	for(size_t i = 0; i < count; ++i)
+		values.push_back(static_cast<char>('a' + i % 26));
+	return values;
+}
+
+// runs r = a <opcode> b for arrays of count elements under level and returns the bytes of r
+template<typename T>
+static std::vector<uint8_t> runArrayOpcode(SimdLevel level, const std::string& opcode, const std::string& resultType, const std::vector<T>& a,
+	const std::vector<T>& b)
+{
+	std::string count = "[" + std::to_string(a.size()) + "]";
+	std::string source = "init:r\ntype:" + resultType + count + "\ninit:a\ntype:" + typeName<T>() + count + "\ninit:b\ntype:" + typeName<T>() + count + "\n" +
+		fill("a", a) + fill("b", b) + "get\nvariable:r\nget\nvariable:a\nget\nvariable:b\n" + opcode + "\n";
+	Processor proc;
+	Parser parser(&proc);
+	proc.setProgram(parser.parse(source));
+	setSimdLevel(level);
+	runCaptured(proc);
+	const FrameLayout& frame = proc.globalFrame();
+	const uint8_t* data = proc.stack().at(0).value() + frame.slotOffset(0);
+	return std::vector<uint8_t>(data, data + frame.slotType(0).size());
+}
+
+template<typename T>
+static std::vector<uint8_t> bytes(const std::vector<T>& values)
+{
+	std::vector<uint8_t> result(values.size() * sizeof(T));
+	memcpy(result.data(), values.data(), result.size());
+	return result;
+}
+
+template<typename T>
+static std::vector<uint8_t> elementwiseReference(ElementwiseOp op, const std::vector<T>& a, const std::vector<T>& b)
+{
+	std::vector<T> result;
+	for(size_t i = 0; i < a.size(); ++i)
+	{
+		if constexpr(std::is_same_v<T, int64_t>) // wraps around like the opcodes
+		{
+			uint64_t x = a[i], y = b[i];
+			result.push_back(op == ElementwiseOp::add ? static_cast<int64_t>(x + y) : op == ElementwiseOp::sub ? static_cast<int64_t>(x - y) :
+				op == ElementwiseOp::mul ? static_cast<int64_t>(x * y) : op == ElementwiseOp::min ? (a[i] < b[i] ? a[i] : b[i]) : (a[i] > b[i] ? a[i] : b[i]));
+		}
+		else
+			result.push_back(op == ElementwiseOp::add ? a[i] + b[i] : op == ElementwiseOp::sub ? a[i] - b[i] : op == ElementwiseOp::mul ? a[i] * b[i] :
+				op == ElementwiseOp::min ? (a[i] < b[i] ? a[i] : b[i]) : (a[i] > b[i] ? a[i] : b[i]));
+	}
+	return bytes(result);
+}
+
+template<typename T>
+static std::vector<uint8_t> compareReference(CompareOp op, const std::vector<T>& a, const std::vector<T>& b)
+{
+	std::vector<uint8_t> result;
+	for(size_t i = 0; i < a.size(); ++i)
+		result.push_back(op == CompareOp::ls ? a[i] < b[i] : op == CompareOp::leq ? a[i] <= b[i] : op == CompareOp::bg ? a[i] > b[i] :
+			op == CompareOp::beq ? a[i] >= b[i] : op == CompareOp::equ ? a[i] == b[i] : a[i] != b[i]);
+	return result;
+}
+
+static const std::vector<std::pair<std::string, ElementwiseOp>> elementwiseOpcodes
+{
+	{"arrAdd", ElementwiseOp::add}, {"arrSub", ElementwiseOp::sub}, {"arrMul", ElementwiseOp::mul}, {"arrMin", ElementwiseOp::min}, {"arrMax", ElementwiseOp::max}
+};
+
+static const std::vector<std::pair<std::string, CompareOp>> compareOpcodes
+{
+	{"arrLs", CompareOp::ls}, {"arrLeq", CompareOp::leq}, {"arrBg", CompareOp::bg}, {"arrBeq", CompareOp::beq}, {"arrEqu", CompareOp::equ}, {"arrNeq", CompareOp::neq}
+};
+
+// every arr* opcode at every supported level gives the scalar result, which matches a plain loop
+template<typename T>
+static void checkArrayOpcodes(const std::vector<T>& a, const std::vector<T>& b, const std::string& what)
+{
+	for(const std::pair<std::string, ElementwiseOp>& opcode : elementwiseOpcodes)
+	{
+		std::vector<uint8_t> expected = elementwiseReference(opcode.second, a, b);
+		for(SimdLevel level : supportedLevels())
+			check(runArrayOpcode(level, opcode.first, typeName<T>(), a, b) == expected, opcode.first + " " + what + " at " + levelName(level));
+	}
+	for(const std::pair<std::string, CompareOp>& opcode : compareOpcodes)
+	{
+		std::vector<uint8_t> expected = compareReference(opcode.second, a, b);
+		for(SimdLevel level : supportedLevels())
+			check(runArrayOpcode(level, opcode.first, "bool", a, b) == expected, opcode.first + " " + what + " at " + levelName(level));
+	}
+}
+
+static void testArrayOpcodes()
+{
+	for(size_t count : lengths)
+	{
+		std::string what = "of " + std::to_string(count);
+		checkArrayOpcodes(int64Values(count, 1), int64Values(count, 2), "int64 " + what);
+		checkArrayOpcodes(doubleValues(count, 3, false), doubleValues(count, 4, false), "double " + what);
+		// NaN in either operand, in both, and signed zeros: min and max pick b unless a compares strictly
+		checkArrayOpcodes(doubleValues(count, 5, true), doubleValues(count, 6, false), "double with NaN in a " + what);
+		checkArrayOpcodes(doubleValues(count, 7, false), doubleValues(count, 8, true), "double with NaN in b " + what);
+		checkArrayOpcodes(doubleValues(count, 9, true), doubleValues(count, 9, true), "double with NaN in both " + what);
+		// char arrays have no elementwise opcodes, at any level
+		for(SimdLevel level : supportedLevels())
+		{
+			check(throws([&]() { runArrayOpcode(level, "arrAdd", "char", charValues(count), charValues(count)); }), "arrAdd rejects char " + what);
+			check(throws([&]() { runArrayOpcode(level, "arrLs", "bool", charValues(count), charValues(count)); }), "arrLs rejects char " + what);
+		}
+	}
+	setSimdLevel(detectedSimdLevel());
+}
+
+// arrays of different types or lengths are rejected even with validation off
+static void testArrayShapes()
+{
+	auto runShapes = [](const std::string& r, const std::string& a, const std::string& b, const std::string& opcode)
+	{
+		Processor proc;
+		Parser parser(&proc);
+		proc.setProgram(parser.parse("init:r\ntype:" + r + "\ninit:a\ntype:" + a + "\ninit:b\ntype:" + b +
+			"\nget\nvariable:r\nget\nvariable:a\nget\nvariable:b\n" + opcode + "\n"));
+		runCaptured(proc);
+	};
+	setValidationLevel(ValidationLevel::none);
+	check(throws([&]() { runShapes("int64[4]", "int64[8]", "int64[8]", "arrAdd"); }), "shorter result array");
+	check(throws([&]() { runShapes("int64[8]", "int64[8]", "int64[4]", "arrAdd"); }), "shorter second array");
+	check(throws([&]() { runShapes("double[8]", "int64[8]", "int64[8]", "arrMin"); }), "result of another element type");
+	check(throws([&]() { runShapes("bool[4]", "int64[8]", "int64[8]", "arrLs"); }), "shorter mask");
+	check(throws([&]() { runShapes("bool[8]", "int64[8]", "int64[4]", "arrEqu"); }), "compare of different lengths");
+	check(throws([&]() { runShapes("int64[8]", "int64[8]", "int64[8]", "arrEqu"); }), "mask of another element type");
+	check(!throws([&]() { runShapes("int64[8]", "int64[8]", "int64[8]", "arrAdd"); }), "matching arrays");
+	setValidationLevel(ValidationLevel::full);
+}
+
+// bpl runs at basic, where the kernels would otherwise read past the shorter array or the value's operand slot
+static void testReductionShapes()
+{
+	auto runShapes = [](const std::string& a, const std::string& b, const std::string& pushB, const std::string& opcode)
+	{
+		Processor proc;
+		Parser parser(&proc);
+		proc.setProgram(parser.parse("init:a\ntype:" + a + "\ninit:b\ntype:" + b + "\nget\nvariable:a\n" + pushB + opcode + "\nprintNum\n"));
+		runCaptured(proc);
+	};
+	const std::string linkB = "get\nvariable:b\n";
+	setValidationLevel(ValidationLevel::basic);
+	check(throws([&]() { runShapes("int64[100]", "int64[1]", linkB, "reduceDot"); }), "reduceDot of a shorter second array");
+	check(throws([&]() { runShapes("int64[1]", "int64[100]", linkB, "reduceDot"); }), "reduceDot of a longer second array");
+	check(throws([&]() { runShapes("int64[8]", "double[8]", linkB, "reduceDot"); }), "reduceDot of another element type");
+	check(!throws([&]() { runShapes("int64[8]", "int64[8]", linkB, "reduceDot"); }), "reduceDot of matching arrays");
+	check(throws([&]() { runShapes("int64[8]", "int64", "valfromarg\nvalue:char:a\n", "countEqu"); }), "countEqu of a char in an int64 array");
+	check(throws([&]() { runShapes("double[8]", "int64", "valfromarg\nvalue:bool:1\n", "countEqu"); }), "countEqu of a bool in a double array");
+	check(!throws([&]() { runShapes("int64[8]", "int64", "valfromarg\nvalue:int64:0\n", "countEqu"); }), "countEqu of a matching value");
+	setValidationLevel(ValidationLevel::full);
+}
+
+// char kernels take 16 and 32 lanes, so their tails need longer arrays
+static const std::vector<size_t> reduceLengths{1, 2, 3, 4, 5, 7, 8, 9, 13, 15, 16, 17, 31, 32, 33, 47, 64, 65};
+
+template<typename T>
+static bool sameBits(T a, T b)
+{
+	return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template<typename T>
+static T strictFold(ReduceOp op, const std::vector<T>& data) // left to right, as the scalar fallback
+{
+	T acc = data[0];
+	for(size_t i = 1; i < data.size(); ++i)
+	{
+		if constexpr(std::is_same_v<T, double>)
+			acc = op == ReduceOp::sum ? acc + data[i] : op == ReduceOp::product ? acc * data[i] : op == ReduceOp::min ? (data[i] < acc ? data[i] : acc) :
+				(data[i] > acc ? data[i] : acc);
+		else // integers wrap around
+			acc = op == ReduceOp::sum ? static_cast<T>(static_cast<uint64_t>(acc) + static_cast<uint64_t>(data[i])) :
+				op == ReduceOp::product ? static_cast<T>(static_cast<uint64_t>(acc) * static_cast<uint64_t>(data[i])) :
+				op == ReduceOp::min ? (data[i] < acc ? data[i] : acc) : (data[i] > acc ? data[i] : acc);
+	}
+	return acc;
+}
+
+static const std::vector<std::pair<std::string, ReduceOp>> reduceOps
+{
+	{"sum", ReduceOp::sum}, {"product", ReduceOp::product}, {"min", ReduceOp::min}, {"max", ReduceOp::max}
+};
+
+template<typename T>
+static std::vector<T> integerData(size_t count)
+{
+	std::vector<T> data;
+	for(int64_t value : int64Values(count, static_cast<int64_t>(count)))
+		data.push_back(static_cast<T>(value));
+	return data;
+}
+
+// values whose sums and products are exact in any order, so reassociated folds must agree with the scalar one
+static std::vector<double> exactDoubles(size_t count)
+{
+	static const double values[] = {0.5, -1.0, 2.0, 1.5, -0.75, 1.0, -2.0, 0.25};
+	std::vector<double> data;
+	for(size_t i = 0; i < count; ++i)
+		data.push_back(values[(i * 5 + count) % 8]);
+	return data;
+}
+
+static void testReductions()
+{
+	for(size_t count : reduceLengths)
+	{
+		std::string what = " of " + std::to_string(count);
+		std::vector<int64_t> longs = integerData<int64_t>(count), otherLongs = integerData<int64_t>(count + 1);
+		std::vector<char> chars = integerData<char>(count), otherChars = integerData<char>(count + 1);
+		std::vector<double> doubles = exactDoubles(count), otherDoubles = exactDoubles(count + 3);
+		std::vector<double> withNaN = doubleValues(count, 11, true);
+		otherLongs.pop_back();
+		otherChars.pop_back();
+		otherDoubles.resize(count);
+		for(SimdLevel level : supportedLevels())
+		{
+			setSimdLevel(level);
+			std::string at = what + " at " + levelName(level);
+			for(const std::pair<std::string, ReduceOp>& op : reduceOps)
+			{
+				check(reduce(op.second, longs.data(), count) == strictFold(op.second, longs), "int64 " + op.first + at);
+				check(reduce(op.second, chars.data(), count) == strictFold(op.second, chars), "char " + op.first + at);
+				check(sameBits(reduce(op.second, doubles.data(), count, false), strictFold(op.second, doubles)), "double " + op.first + at);
+				check(sameBits(reduce(op.second, doubles.data(), count, true), strictFold(op.second, doubles)), "reassociated double " + op.first + at);
+				check(sameBits(reduce(op.second, withNaN.data(), count, false), strictFold(op.second, withNaN)), "double " + op.first + " with NaN" + at);
+			}
+			int64_t longDot = 0;
+			char charDot = 0;
+			double doubleDot = 0;
+			for(size_t i = 0; i < count; ++i)
+			{
+				longDot = static_cast<int64_t>(static_cast<uint64_t>(longDot) + static_cast<uint64_t>(longs[i]) * static_cast<uint64_t>(otherLongs[i]));
+				charDot = static_cast<char>(charDot + chars[i] * otherChars[i]);
+				doubleDot += doubles[i] * otherDoubles[i];
+			}
+			check(dot(longs.data(), otherLongs.data(), count) == longDot, "int64 dot" + at);
+			check(dot(chars.data(), otherChars.data(), count) == charDot, "char dot" + at);
+			check(sameBits(dot(doubles.data(), otherDoubles.data(), count, false), doubleDot), "double dot" + at);
+			check(sameBits(dot(doubles.data(), otherDoubles.data(), count, true), doubleDot), "reassociated double dot" + at);
+
+			check(countEqual(longs.data(), longs[count / 2], count) == static_cast<size_t>(std::count(longs.begin(), longs.end(), longs[count / 2])), "int64 countEqu" + at);
+			check(countEqual(chars.data(), chars[count - 1], count) == static_cast<size_t>(std::count(chars.begin(), chars.end(), chars[count - 1])), "char countEqu" + at);
+			check(countEqual(doubles.data(), doubles[0], count) == static_cast<size_t>(std::count(doubles.begin(), doubles.end(), doubles[0])), "double countEqu" + at);
+			// NaN equals nothing, -0.0 equals 0.0
+			check(countEqual(withNaN.data(), std::numeric_limits<double>::quiet_NaN(), count) == 0, "countEqu of NaN" + at);
+			check(countEqual(withNaN.data(), 0.0, count) == static_cast<size_t>(std::count(withNaN.begin(), withNaN.end(), 0.0)), "countEqu of zero" + at);
+		}
+	}
+	setSimdLevel(detectedSimdLevel());
+}
+
+// reduceSum without :fast adds in index order at every level, so rounding matches a left to right loop bit for bit
+static void testStrictDoubleSum()
+{
+	std::vector<double> data;
+	data.push_back(1e16); // every later addend alone is below half an ulp of the running sum, together they aren't
+	for(size_t i = 1; i < 37; ++i)
+		data.push_back(i % 2 == 0 ? 1.0 : 0.75);
+	double expected = strictFold(ReduceOp::sum, data);
+	std::vector<double> pairwise(data);
+	for(size_t width = 1; width < pairwise.size(); width *= 2)
+		for(size_t i = 0; i + width < pairwise.size(); i += 2 * width)
+			pairwise[i] += pairwise[i + width];
+	check(!sameBits(pairwise[0], expected), "the data rounds differently when reassociated");
+
+	std::string source = "init:s\ntype:double\ninit:a\ntype:double[" + std::to_string(data.size()) + "]\n" + fill("a", data) +
+		"get\nvariable:s\nget\nvariable:a\nreduceSum\nset\n";
+	for(SimdLevel level : supportedLevels())
+	{
+		Processor proc;
+		Parser parser(&proc);
+		proc.setProgram(parser.parse(source));
+		setSimdLevel(level);
+		runCaptured(proc);
+		double sum;
+		memcpy(&sum, proc.stack().at(0).value() + proc.globalFrame().slotOffset(0), sizeof(sum));
+		check(sameBits(sum, expected), "reduceSum matches the left to right fold at " + levelName(level));
+	}
+	setSimdLevel(detectedSimdLevel());
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testArrayOpcodes();
+	testArrayShapes();
+	testReductionShapes();
+	testReductions();
+	testStrictDoubleSum();
+	return failures() == 0 ? 0 : 1;
+}
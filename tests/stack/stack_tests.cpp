@@ -0,0 +1,72 @@
+#include "../bpl_test.h"
+
+static bool hugeBacked(const Stack& stack)
+{
+	return stack.hugetlb() || stack.transparentHuge();
+}
+
+static void testHugePagesOptIn()
+{
+	const size_t twoMiB = 2 << 20;
+
+	Processor reserved(0, false);
+	reserved.reserveStack(twoMiB);
+	check(reserved.stack().capacity() == twoMiB && !hugeBacked(reserved.stack()), "2 MiB reservation without huge pages stays on 4 KiB pages");
+
+	Processor constructed(twoMiB, false);
+	check(!hugeBacked(constructed.stack()), "2 MiB stack constructed without huge pages stays on 4 KiB pages");
+
+	Processor types;
+	setAllowResizeStack(true);
+	Stack grown(&types, 0, false, false);
+	grown.push(ElementInfo(TypeVariant(ArrayType(TypeVariant(types.charType()), 1 << 20)))); // growth doubles to exactly 2 MiB
+	setAllowResizeStack(false);
+	check(grown.capacity() == twoMiB && !hugeBacked(grown), "growth to 2 MiB without huge pages stays on 4 KiB pages");
+
+	Processor huge(0, true);
+	huge.reserveStack(twoMiB);
+	check(hugeBacked(huge.stack()), "huge page stack is backed by huge pages");
+}
+
+static bool aligned(const uint8_t* data, size_t alignment)
+{
+	return reinterpret_cast<uintptr_t>(data) % alignment == 0;
+}
+
+// every element after a char starts at an address that is a multiple of its type's alignment
+static void testElementAlignment()
+{
+	Processor types;
+	TypeVariant charType(types.charType());
+	StructType natural({charType, TypeVariant(types.doubleType())}, {"c", "d"}, StructLayout::natural);
+	StructType packed({charType, TypeVariant(types.int64Type())}, {"c", "i"}, StructLayout::packed);
+	StructType line({charType}, {"c"}, StructLayout::natural, 64);
+	std::vector<std::pair<TypeVariant, size_t>> cases
+	{
+		{TypeVariant(types.int64Type()), 8},
+		{TypeVariant(types.doubleType()), 8},
+		{TypeVariant(ArrayType(TypeVariant(types.int64Type()), 3)), 8},
+		{TypeVariant(&natural), 8},
+		{TypeVariant(&packed), 1},
+		{TypeVariant(&line), 64}
+	};
+	for(const std::pair<TypeVariant, size_t>& testCase : cases)
+	{
+		Stack stack(&types, 4096, false, false);
+		stack.push(ElementInfo(charType));
+		uint8_t* data = stack.push(ElementInfo(testCase.first));
+		size_t pos = data - stack.data();
+		check(aligned(data, testCase.second) && pos % testCase.second == 0, "element after a char is aligned to " + std::to_string(testCase.second));
+		check(testCase.second != 1 || pos == 1, "packed struct follows a char without padding");
+		stack.pop();
+		check(stack.top() == 1, "pop drops the alignment padding");
+	}
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testHugePagesOptIn();
+	testElementAlignment();
+	return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include "../bpl_test.h"
+
+#include <thread>
+
+static const StructType& structAt(TypeId id)
+{
+	return *TypeTable::instance().type(id).get<const StructType*>();
+}
+
+// types interned by a Processor stay valid and distinct after it is destroyed and another one is built
+static void testSequentialProcessors()
+{
+	TypeTable& table = TypeTable::instance();
+	TypeId int64Id, doubleId, pairId, arrayId, frameId;
+	{
+		Processor first;
+		first.addStruct(StructType(std::vector<TypeVariant>{TypeVariant(first.int64Type()), TypeVariant(first.charType())},
+			std::vector<std::string>{"a", "b"}, StructLayout::natural), "pair");
+		int64Id = table.intern(TypeVariant(first.int64Type()));
+		doubleId = table.intern(TypeVariant(first.doubleType()));
+		pairId = table.intern(first.typeByName("pair").value());
+		arrayId = table.intern(TypeVariant(ArrayType(TypeVariant(first.doubleType()), 4)));
+		Parser parser(&first);
+		first.setProgram(parser.parse("init:x\ntype:int64\ninit:y\ntype:char\n"));
+		frameId = table.intern(TypeVariant(&first.globalFrame().type()));
+		check(runCaptured(first).empty(), "first processor runs");
+	}
+	check(int64Id != doubleId, "int64 and double of the same size are distinct types");
+
+	Processor second;
+	second.addStruct(StructType(std::vector<TypeVariant>{TypeVariant(second.charType()), TypeVariant(second.doubleType())},
+		std::vector<std::string>{"c", "d"}, StructLayout::natural), "other");
+	TypeId otherId = table.intern(second.typeByName("other").value());
+	check(table.intern(TypeVariant(second.int64Type())) == int64Id, "int64 keeps its id across processors");
+	check(table.intern(TypeVariant(second.doubleType())) == doubleId, "double keeps its id across processors");
+	check(otherId != pairId, "a new struct doesn't alias one of the destroyed processor");
+
+	check(table.type(int64Id) == TypeVariant(second.int64Type()) && table.size(int64Id) == sizeof(int64_t), "int64 id resolves to int64");
+	check(table.type(doubleId) == TypeVariant(second.doubleType()), "double id resolves to double");
+	check(table.size(pairId) == 16 && structAt(pairId).fieldNames() == std::vector<std::string>{"a", "b"}, "struct id of the destroyed processor still resolves");
+	check(structAt(pairId).typeId(1) == int64Id && structAt(pairId).typeId(2) == table.intern(TypeVariant(second.charType())), "struct fields resolve");
+	check(table.size(otherId) == 16 && structAt(otherId).fieldNames() == std::vector<std::string>{"c", "d"}, "new struct id resolves");
+	check(table.type(arrayId).get<ArrayType>().elementTypeId() == doubleId && table.size(arrayId) == 32, "array id resolves");
+	check(table.size(frameId) == 16 && structAt(frameId).fieldNames() == std::vector<std::string>{"x", "y"}, "frame id resolves");
+
+	// the same struct declared again is the same type
+	second.addStruct(StructType(std::vector<TypeVariant>{TypeVariant(second.int64Type()), TypeVariant(second.charType())},
+		std::vector<std::string>{"a", "b"}, StructLayout::natural), "pair");
+	check(table.intern(second.typeByName("pair").value()) == pairId, "structurally equal struct gets the same id");
+	check(second.typeByName("pair").value() == table.type(pairId), "structurally equal struct is the same object");
+	StructType local(std::vector<TypeVariant>{TypeVariant(second.int64Type()), TypeVariant(second.charType())},
+		std::vector<std::string>{"a", "b"}, StructLayout::packed);
+	check(table.intern(TypeVariant(&local)) != pairId, "packed layout is another type");
+
+	Parser parser(&second);
+	second.setProgram(parser.parse("init:x\ntype:int64\ninit:y\ntype:char\n"));
+	check(table.intern(TypeVariant(&second.globalFrame().type())) == frameId, "equal frames share a type");
+}
+
+static bool hasLayout(const StructType& type, const std::vector<size_t>& offsets, size_t size, size_t alignment)
+{
+	for(size_t i = 0; i < offsets.size(); ++i)
+	{
+		if(type.offsetBySize(i + 1) != offsets[i])
+			return false;
+	}
+	return type.size() == size && type.alignment() == alignment;
+}
+
+static void testStructLayouts()
+{
+	Processor proc;
+	TypeVariant charType(proc.charType());
+	TypeVariant int64Type(proc.int64Type());
+	TypeVariant doubleType(proc.doubleType());
+	std::vector<TypeVariant> mixed{charType, int64Type, doubleType};
+	std::vector<std::string> mixedNames{"c", "i", "d"};
+
+	check(hasLayout(StructType(mixed, mixedNames, StructLayout::natural), {0, 8, 16}, 24, 8), "natural char, int64, double");
+	check(hasLayout(StructType(mixed, mixedNames, StructLayout::packed), {0, 1, 9}, 17, 1), "packed char, int64, double");
+	check(hasLayout(StructType({int64Type, charType}, {"i", "c"}, StructLayout::natural), {0, 8}, 16, 8), "natural tail padding");
+	check(hasLayout(StructType({int64Type, charType}, {"i", "c"}, StructLayout::packed), {0, 8}, 9, 1), "packed has no tail padding");
+	check(hasLayout(StructType({charType, charType, doubleType, charType}, {"a", "b", "d", "e"}, StructLayout::natural), {0, 1, 8, 16}, 24, 8),
+		"natural chars around a double");
+	check(hasLayout(StructType({charType, TypeVariant(ArrayType(int64Type, 2))}, {"c", "a"}, StructLayout::natural), {0, 8}, 24, 8),
+		"natural array field is aligned to its element");
+
+	StructType inner({charType, doubleType}, {"c", "d"}, StructLayout::natural);
+	check(hasLayout(StructType({charType, TypeVariant(&inner)}, {"c", "s"}, StructLayout::natural), {0, 8}, 24, 8), "natural nested struct");
+	check(hasLayout(StructType({charType, TypeVariant(&inner)}, {"c", "s"}, StructLayout::packed), {0, 1}, 17, 1), "packed nested natural struct");
+
+	check(hasLayout(StructType({charType}, {"c"}, StructLayout::natural, 64), {0}, 64, 64), "explicit cache line alignment");
+	check(hasLayout(StructType(mixed, mixedNames, StructLayout::packed, 16), {0, 1, 9}, 32, 16), "explicit alignment keeps packed offsets");
+	check(hasLayout(StructType(mixed, mixedNames, StructLayout::natural, 4), {0, 8, 16}, 24, 8), "smaller explicit alignment doesn't lower natural");
+	check(throws([&]() { StructType(mixed, mixedNames, StructLayout::natural, 12); }), "alignment must be a power of two");
+}
+
+// slots are laid out without touching the table, the frame struct is interned once when the layout is first used
+static void testFrameLayout()
+{
+	Processor proc;
+	TypeVariant charType(proc.charType());
+	TypeVariant int64Type(proc.int64Type());
+	TypeVariant arrayType(ArrayType(TypeVariant(proc.doubleType()), 3));
+	TypeTable& table = TypeTable::instance();
+	for(const TypeVariant& slotType : {charType, int64Type, arrayType})
+		table.intern(slotType);
+	size_t before = table.structCount();
+	FrameLayout frame;
+	std::vector<TypeVariant> types;
+	std::vector<std::string> names;
+	for(size_t i = 0; i < 300; ++i)
+	{
+		types.push_back(i % 3 == 0 ? charType : i % 3 == 1 ? int64Type : arrayType);
+		names.push_back("frameLayoutSlot" + std::to_string(i));
+		frame.addSlot(types.back(), names.back());
+	}
+	check(table.structCount() == before, "adding slots interns no struct");
+	StructType expected(types, names, StructLayout::natural);
+	const StructType& type = frame.type();
+	check(table.structCount() == before + 1 && &frame.type() == &type, "the frame struct is interned once");
+	check(type == expected && frame.size() == expected.size() && frame.elementCount() == expected.elementCount(), "frame size matches its struct");
+	bool sameSlots = true;
+	for(size_t slot = 0; slot < frame.slotCount(); ++slot)
+		sameSlots = sameSlots && frame.slotOffset(slot) == expected.offsetBySize(slot + 1) && frame.slotIndex(slot) == expected.elementSubIndex(slot + 1);
+	check(sameSlots, "slot offsets and sub-indexes match the struct");
+	frame.addSlot(charType, "frameLayoutSlotLast");
+	check(&frame.type() != &type && frame.type().size() == frame.size(), "a slot added after use interns the grown struct");
+}
+
+// enough types to grow the table's chunk directory several times while other threads read ids through it
+static void testConcurrentInterning()
+{
+	Processor proc;
+	const size_t threadCount = 4;
+	const size_t perThread = 20000;
+	std::vector<std::vector<TypeId>> ids(threadCount);
+	std::vector<std::thread> threads;
+	std::atomic<bool> readBack(true);
+	for(size_t t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([&proc, &ids, &readBack, t]()
+		{
+			for(size_t count = 1; count <= perThread; ++count)
+			{
+				ids[t].push_back(TypeTable::instance().intern(TypeVariant(ArrayType(TypeVariant(proc.charType()), 100000 + count))));
+				if(TypeTable::instance().size(ids[t][count / 2]) != 100000 + count / 2 + 1)
+					readBack = false;
+			}
+		});
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+	bool same = true;
+	bool resolved = true;
+	for(size_t t = 1; t < threadCount; ++t)
+		same = same && ids[t] == ids[0];
+	for(size_t count = 1; count <= perThread; ++count)
+		resolved = resolved && TypeTable::instance().size(ids[0][count - 1]) == 100000 + count;
+	check(same, "threads interning the same types get the same ids");
+	check(readBack.load(), "ids resolve while other threads grow the table");
+	check(resolved, "ids interned concurrently resolve to their types");
+}
+
+int main()
+{
+	setValidationLevel(ValidationLevel::full);
+	testSequentialProcessors();
+	testStructLayouts();
+	testFrameLayout();
+	testConcurrentInterning();
+	return failures() == 0 ? 0 : 1;
+}